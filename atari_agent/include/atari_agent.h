@@ -7,8 +7,10 @@
 #include <drla/callback.h>
 #include <drla/environment.h>
 
+#include <deque>
 #include <filesystem>
 #include <memory>
+#include <mutex>
 
 namespace atari
 {
@@ -29,14 +31,27 @@ public:
 	/// @param env_count The number of environments to run
 	/// @param options Options which change various behaviours of the agent. See RunOptions for more detail on available
 	/// options.
-	void run(int env_count, drla::RunOptions options = {});
+	/// @param seed The emulator seed of the first environment, with each following environment using the next seed. This
+	/// makes a run reproducible regardless of the order the environments are created in. Negative values keep the seeds
+	/// from the configuration.
+	void run(int env_count, drla::RunOptions options = {}, int seed = -1);
 
 private:
 	std::unique_ptr<drla::Environment> make_environment() override;
 	drla::State get_initial_state() override;
 
+	/// @brief Creates the environments a run starts with concurrently, ready for make_environment to hand out
+	/// @param env_count The number of environments to create
+	void prepare_environments(int env_count);
+
 	const ConfigData config_;
 	std::unique_ptr<drla::Agent> agent_;
+
+	std::mutex m_envs_;
+	// Environments created ahead of time by prepare_environments
+	std::deque<std::unique_ptr<drla::Environment>> prepared_envs_;
+	// The index of the next environment created, which is added to the configured seed
+	int next_env_index_ = 0;
 };
 
 } // namespace atari
@@ -4,7 +4,9 @@
 
 #include <array>
 #include <cstddef>
+#include <memory>
 #include <string>
+#include <vector>
 
 namespace atari
 {
@@ -12,18 +14,51 @@ namespace atari
 namespace Config
 {
 
+// The observations output by the environment
+enum class ObservationMode
+{
+	// The preprocessed screen pixels
+	kPixels,
+	// The 128 bytes of console RAM
+	kRAM,
+	// The pixels as the first observation and the RAM as the second
+	kPixelsAndRAM,
+};
+
 struct AtariEnv
 {
 	// The location of the ROM file to load
 	std::string rom_file;
+	// The seed of the emulator's random number generator, making runs reproducible. Each environment adds its index to
+	// the seed. Negative values use a random seed.
+	int seed = -1;
 	// End the episode when a life is lost, but don't reset the environment until lives is 0
 	bool end_episode_on_life_loss = false;
 	// Bin reward to {+1, 0, -1} by its sign.
 	bool clip_reward = false;
 	// Return only every n frames. Values <= 1 will return every frame.
 	int frame_skip = 1;
-	// The number of frames to perform noops for on reset
+	// The number of frames to perform noops for on reset. Without the reset state bank every game starts after exactly
+	// this many noops.
 	int noop_reset_max_frames = 0;
+	// The number of distinct start states to cache and sample from on reset instead of emulating the noops each time.
+	// Each state is captured lazily the first time it is sampled and uses a different number of noops, from
+	// noop_reset_max_frames down, so the bank size is limited to noop_reset_max_frames + 1. 0 disables the bank.
+	// Enabling the bank changes the start state distribution, so results differ from training without it: games start
+	// after noop counts spread evenly over [0, noop_reset_max_frames], uniformly over all of them when the bank size is
+	// noop_reset_max_frames + 1, rather than always after noop_reset_max_frames. Games started from the same cached state
+	// are identical until they diverge via sticky actions, which are drawn from the emulator's random number generator as
+	// it runs on rather than the generator's state when the start state was cached. Disabled by default, so only set this
+	// when the changed distribution is acceptable.
+	int reset_state_bank_size = 0;
+	// Start the next game ahead of time on a low priority background thread, using a second emulator instance per
+	// environment, so a reset only swaps in the prepared game. Not used when the reset state bank is enabled.
+	bool reset_ahead = false;
+	// Record each game as its start state and action sequence, which can be replayed to regenerate its frames. Not
+	// supported with the reset state bank.
+	bool record_episodes = false;
+	// The observations to output. The RAM is stacked in the same way as the pixel frames.
+	ObservationMode observation_mode = ObservationMode::kPixels;
 	// The number of frames to stack and output as an observation. (0 and 1 output a single frame)
 	int frame_stack = 1;
 	// Uses grayscale observations
@@ -32,10 +67,32 @@ struct AtariEnv
 	std::array<int, 2> output_resolution = {0, 0};
 	// Convert the observation data to floats, scaling to the range [0, 1].
 	bool use_float = false;
+	// Capture visualisations as the screen's palette indices and the palette, rather than RGB, using a third of the
+	// memory. Conversion to RGB is deferred until the visualisation is displayed or saved.
+	bool indexed_visualisations = false;
+	// The number of threads creating an agent's environments when it starts. Values <= 0 use the number of hardware
+	// threads, while 1 creates them one after another.
+	int construction_thread_count = 0;
+	// The sets of CPUs the environments are pinned to, such as the cores of each NUMA node. Environment i uses set
+	// i % cpu_affinity.size(), which the threads creating and stepping it are pinned to, so its memory is allocated on
+	// that node. This assumes the agent steps each environment on a thread of its own. A vector environment pins its
+	// worker w to set w % cpu_affinity.size() instead. Empty doesn't pin any threads.
+	std::vector<std::vector<int>> cpu_affinity;
 };
 
 } // namespace Config
 
+// What the training logger does with heavy logging work, such as images and animations, when its queue is backlogged
+enum class LogBackpressure
+{
+	// Wait for space in the queue, stalling training until the logger catches up
+	kBlock,
+	// Drop heavy work while the queue is full
+	kDrop,
+	// Keep only every log_sample_interval-th heavy task while the queue is at least half full, dropping all when full
+	kSample,
+};
+
 struct ConfigData
 {
 	// The atari environment configuration
@@ -50,13 +107,35 @@ struct ConfigData
 	// Every n episodes save the entire episode as a gif
 	int observation_gif_save_period = 10000;
 
+	// Only every n-th frame of a captured episode is added to its gif. Values <= 1 add every frame.
+	int gif_frame_decimation = 1;
+
+	// Captured episodes are logged to tensorboard as animations once complete, so their memory grows with the episode
+	// length. Enabling this instead encodes them to gif files as they are played, using constant memory.
+	bool stream_gifs = false;
+
 	// Every n train timesteps log any images from metrics
 	int metric_image_log_period = 1000;
+
+	// The maximum number of logging tasks queued for the background logging thread
+	int log_queue_size = 64;
+
+	// How heavy logging work is handled when the logging queue is backlogged. Scalars are never dropped.
+	LogBackpressure log_backpressure = LogBackpressure::kBlock;
+
+	// The interval of heavy logging tasks kept by the sample backpressure policy
+	int log_sample_interval = 4;
 };
 
+struct EpisodeRecording;
+
 struct EnvState
 {
 	int lives = 0;
+	// When >= 0 in the initial state passed to reset, the environment is reseeded with this emulator seed
+	int seed = -1;
+	// The recording of the game, only set on the last step of a game when recording episodes
+	std::shared_ptr<const EpisodeRecording> recording;
 };
 
 } // namespace atari
@@ -0,0 +1,118 @@
+#pragma once
+
+#include "gif_writer.h"
+
+#include <drla/types.h>
+
+#include <array>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+namespace atari
+{
+
+class ThreadPool;
+
+/// @brief A worker thread which encodes the frames of GifStreams. One encoder is shared by all the streams of a run, so
+/// capturing an episode doesn't start a thread.
+class GifEncoder
+{
+public:
+	/// @brief Starts the worker thread
+	GifEncoder();
+
+	/// @brief Completes all queued tasks, then stops the worker thread
+	~GifEncoder();
+
+	GifEncoder(const GifEncoder&) = delete;
+	GifEncoder& operator=(const GifEncoder&) = delete;
+
+	/// @brief Queues a task on the worker thread. Tasks run in the order they are submitted, so a task submitted after
+	/// a stream's last frame can close the stream without waiting.
+	/// @param task The task to run
+	void submit(std::function<void()> task);
+
+private:
+	std::unique_ptr<ThreadPool> pool_;
+};
+
+/// @brief Encodes environment visualisations to a GIF animation as they are captured. Frames are copied into a fixed
+/// number of recycled buffers and encoded on the encoder's worker thread, so the memory used is constant regardless of
+/// the episode length. Adding a frame blocks only when all buffers are waiting to be encoded.
+class GifStream
+{
+public:
+	/// @brief Creates the stream. The file is opened when the first frame is added.
+	/// @param encoder The encoder the frames are encoded on, which must outlive the stream
+	/// @param path The path of the GIF file
+	/// @param delay The delay between consecutive visualisations in hundredths of a second. Decimated frames are shown
+	/// for proportionally longer, keeping the animation's speed.
+	/// @param frame_decimation Only every n-th visualisation is added to the animation. Values <= 1 add every frame.
+	/// @param buffer_count The number of frames which can be waiting to be encoded
+	GifStream(
+		GifEncoder& encoder,
+		const std::filesystem::path& path,
+		int delay,
+		int frame_decimation = 1,
+		int buffer_count = 32);
+	~GifStream();
+
+	GifStream(const GifStream&) = delete;
+	GifStream& operator=(const GifStream&) = delete;
+
+	/// @brief Adds a visualisation to the animation, subject to the frame decimation. Either an RGB image [H, W, 3] or
+	/// palette indices [H, W] with the palette [256, 3]. RGB colours are mapped to a palette of the first 256 distinct
+	/// colours seen, which covers all colours the Atari can display.
+	/// @param visualisation The visualisation returned by the environment
+	void add_frame(const drla::Observations& visualisation);
+
+	/// @brief Waits for all added frames to be encoded and closes the file. Called automatically on destruction. The
+	/// stream may be closed on a different thread to the one which added the frames.
+	void close();
+
+	/// @brief The number of frames added to the animation, after decimation
+	int frame_count() const;
+
+private:
+	struct Frame
+	{
+		std::vector<uint8_t> pixels;
+		std::array<uint8_t, GifWriter::kPaletteSize * 3> palette;
+		bool indexed = false;
+	};
+
+	void encode_next();
+	const uint8_t* quantise(const std::vector<uint8_t>& rgb);
+
+	GifEncoder& encoder_;
+	const std::filesystem::path path_;
+	const int delay_;
+	const int frame_decimation_;
+	const int buffer_count_;
+	int visualisation_count_ = 0;
+	int frame_count_ = 0;
+
+	std::unique_ptr<GifWriter> writer_;
+
+	std::mutex m_frames_;
+	std::condition_variable cv_free_;
+	std::deque<Frame> queued_frames_;
+	std::vector<Frame> free_frames_;
+	int allocated_frames_ = 0;
+	// The frames queued or being encoded
+	int pending_frames_ = 0;
+
+	// Only used by the encoder's worker thread, to map RGB frames to palette indices
+	std::unordered_map<uint32_t, uint8_t> colour_indices_;
+	std::array<uint8_t, GifWriter::kPaletteSize * 3> rgb_palette_ = {};
+	std::vector<uint8_t> indices_;
+};
+
+} // namespace atari
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <vector>
+
+namespace atari
+{
+
+/// @brief Writes palette indexed frames to a looping GIF animation as they are added, without expanding them to RGB.
+class GifWriter
+{
+public:
+	/// @brief The number of entries in a palette
+	static constexpr int kPaletteSize = 256;
+
+	/// @brief Opens the GIF file for writing
+	/// @param path The path of the GIF file
+	/// @param width The width of each frame in pixels
+	/// @param height The height of each frame in pixels
+	/// @param delay The delay between frames in hundredths of a second
+	GifWriter(const std::filesystem::path& path, int width, int height, int delay);
+	~GifWriter();
+
+	/// @brief Adds a frame to the animation. The palette of the first frame is written as the global colour table, later
+	/// frames with a different palette include their own local colour table.
+	/// @param indices The palette index of each pixel, [H, W]
+	/// @param palette The RGB colour of each palette index, [256, 3]
+	void add_frame(const uint8_t* indices, const uint8_t* palette);
+
+	/// @brief Finishes the animation and closes the file. Called automatically on destruction.
+	void close();
+
+private:
+	void write_header(const uint8_t* palette);
+	void write_image_data(const uint8_t* indices);
+
+	std::ofstream file_;
+	const int width_;
+	const int height_;
+	const int delay_;
+	bool header_written_ = false;
+	std::array<uint8_t, kPaletteSize * 3> global_palette_ = {};
+	// Reused between frames to hold the LZW compressed image data
+	std::vector<uint8_t> image_data_;
+	std::vector<int32_t> lzw_keys_;
+	std::vector<uint16_t> lzw_codes_;
+};
+
+} // namespace atari
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+
+// Defined by the build. When disabled the scopes are compiled out and all counters remain zero.
+#ifndef ATARI_ENABLE_PERF
+#define ATARI_ENABLE_PERF 1
+#endif
+
+namespace atari
+{
+
+/// @brief The instrumented stages of the environment hot path and the training callbacks
+enum class PerfStage
+{
+	// A whole environment step, including emulation and preprocessing
+	kStep,
+	// A single emulator frame
+	kEmulation,
+	// Max pooling and preprocessing the screen into the frame stack
+	kPreprocess,
+	// Writing the frame stack to the observation
+	kObservation,
+	// Resetting the environment
+	kReset,
+	// Creating the visualisations of the environment
+	kVisualisation,
+	// The training callbacks
+	kEnvResetCallback,
+	kEnvStepCallback,
+	kTrainUpdateCallback,
+	kCount,
+};
+
+inline constexpr int kPerfStageCount = static_cast<int>(PerfStage::kCount);
+inline constexpr bool kPerfEnabled = ATARI_ENABLE_PERF != 0;
+
+/// @brief The number of times a stage ran and the total time spent in it
+struct PerfCounter
+{
+	uint64_t calls = 0;
+	uint64_t ns = 0;
+};
+
+using PerfCounters = std::array<PerfCounter, kPerfStageCount>;
+
+/// @brief The name of a stage, used when logging the counters
+const char* perf_stage_name(PerfStage stage);
+
+/// @brief Adds a call of a stage to the calling thread's counters
+/// @param stage The stage which was run
+/// @param ns The time spent in the stage in nanoseconds
+void perf_record(PerfStage stage, uint64_t ns);
+
+/// @brief Sums the counters of all threads, including threads which have exited. The counters only increase, so the
+/// difference between two totals gives the counts of the interval between them.
+PerfCounters perf_totals();
+
+/// @brief Records the time from construction to destruction against a stage
+class PerfScope
+{
+public:
+	explicit PerfScope(PerfStage stage) : stage_(stage), start_(std::chrono::steady_clock::now()) {}
+
+	~PerfScope()
+	{
+		const auto elapsed = std::chrono::steady_clock::now() - start_;
+		perf_record(stage_, std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count());
+	}
+
+	PerfScope(const PerfScope&) = delete;
+	PerfScope& operator=(const PerfScope&) = delete;
+
+private:
+	const PerfStage stage_;
+	const std::chrono::steady_clock::time_point start_;
+};
+
+} // namespace atari
+
+#if ATARI_ENABLE_PERF
+#define ATARI_PERF_CONCAT_IMPL(a, b) a##b
+#define ATARI_PERF_CONCAT(a, b) ATARI_PERF_CONCAT_IMPL(a, b)
+/// @brief Times the rest of the enclosing scope against a stage
+#define ATARI_PERF_SCOPE(stage) const ::atari::PerfScope ATARI_PERF_CONCAT(perf_scope_, __LINE__)(stage)
+#else
+#define ATARI_PERF_SCOPE(stage)
+#endif
@@ -0,0 +1,117 @@
+#pragma once
+
+#include "atari_agent/configuration.h"
+
+#include <torch/torch.h>
+
+#include <cstdint>
+#include <vector>
+
+namespace atari
+{
+
+/// @brief The precomputed bins of an area (adaptive average pooling) resize along one output dimension
+struct AreaResizePlan
+{
+	// The output dimension size
+	int output_size = 0;
+	// The first input index of each output bin
+	std::vector<int> start;
+	// One past the last input index of each output bin
+	std::vector<int> end;
+	// The maximum bin size over all output bins
+	int max_size = 0;
+	// The input index of tap k for each output bin, clamped to the bin. Laid out as [max_size][output_size].
+	std::vector<int32_t> tap_index;
+	// All bits set when tap k is within the output bin, otherwise 0. Laid out as [max_size][output_size].
+	std::vector<int32_t> tap_mask;
+	// The size of each output bin as a float
+	std::vector<float> bin_size;
+};
+
+/// @brief The instruction sets the preprocessing kernels can use
+enum class SimdLevel
+{
+	kScalar,
+	kSSE2,
+	kAVX2,
+};
+
+/// @brief The widest instruction set the CPU supports, which the kernels use by default
+SimdLevel detect_simd_level();
+
+/// @brief Converts ALE screens into observations in a single pass, performing any resizing and data type conversion
+/// directly into the destination observation slot without intermediate allocations. The area resize replicates the
+/// floating point operations of torch's area interpolation so the output is bit exact with it. AVX2 and SSE2 kernels
+/// are selected on construction when supported, with a scalar fallback otherwise.
+///
+/// Each combination of channel count, resizing and output data type is a separate pipeline specialised at compile time,
+/// with the pipeline matching the configuration selected once on construction.
+class FramePreprocessor
+{
+public:
+	/// @brief Creates a preprocessor for the environment configuration
+	/// @param config The environment configuration, defining the channels, output resolution and data type
+	/// @param screen_height The height of the ALE screen
+	/// @param screen_width The width of the ALE screen
+	/// @param simd_level The widest instruction set the kernels may use, limited to what the CPU supports
+	FramePreprocessor(
+		const Config::AtariEnv& config, int screen_height, int screen_width, SimdLevel simd_level = detect_simd_level());
+
+	/// @brief Preprocesses a screen in ALE's interleaved [H, W, C] grayscale or RGB layout
+	/// @param screen The screen buffer, as output by getScreenGrayscale() or getScreenRGB()
+	/// @param dst The contiguous [C, H, W] destination observation, which must be of the configured data type
+	void process(const uint8_t* screen, torch::Tensor dst);
+
+	/// @brief Preprocesses a screen, writing the observation of the configured data type to dst. Byte observations are
+	/// uint8_t and float observations are scaled to the range [0, 1].
+	void process(const uint8_t* screen, void* dst);
+
+	/// @brief Takes the element-wise maximum of two screen buffers, pooling over consecutive frames to remove flicker.
+	/// @param screen The screen buffer to pool with dst
+	/// @param dst The screen buffer to pool with and write the result to
+	void max_pool(const uint8_t* screen, uint8_t* dst) const;
+
+	/// @brief The number of bytes in a screen buffer
+	int screen_size() const;
+
+	/// @brief The shape of the output frame, [C, H, W]
+	std::vector<int64_t> frame_shape() const;
+
+	using MaxPoolFn = void (*)(const uint8_t* src, uint8_t* dst, int size);
+	template <typename T>
+	using ResizeColumnsFn = void (*)(const float* rows, int row_stride, int kh, const AreaResizePlan& plan, T* dst);
+
+private:
+	using PipelineFn = void (FramePreprocessor::*)(const uint8_t*, void*);
+
+	template <int Channels, bool Resize, typename T>
+	void run(const uint8_t* screen, void* dst);
+
+	template <int Channels>
+	PipelineFn select_pipeline() const;
+
+	template <int Channels, typename T>
+	void resize(const uint8_t* screen, T* dst);
+
+	template <int Channels, typename T>
+	void convert(const uint8_t* screen, T* dst);
+
+	const int channels_;
+	const int screen_height_;
+	const int screen_width_;
+	const bool resize_;
+	const bool use_float_;
+
+	AreaResizePlan rows_;
+	AreaResizePlan cols_;
+
+	PipelineFn pipeline_;
+	MaxPoolFn max_pool_fn_;
+	ResizeColumnsFn<uint8_t> resize_bytes_fn_;
+	ResizeColumnsFn<float> resize_floats_fn_;
+	// Scratch space for the scaled input rows of the output row currently being resized
+	std::vector<float> row_buffer_;
+};
+
+} // namespace atari
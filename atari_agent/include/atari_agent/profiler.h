@@ -0,0 +1,127 @@
+#pragma once
+
+#include "atari_agent/configuration.h"
+
+#include <drla/callback.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace atari
+{
+
+/// @brief The policy used to choose actions while profiling
+enum class ProfilePolicy
+{
+	// The agent's model, run via the agent
+	kModel,
+	// Uniformly random actions
+	kRandom,
+	// Always the first action, which is a noop
+	kFixed,
+};
+
+/// @brief Where the time of a profiled run was spent. Times are in seconds, summed over all environment threads.
+struct ProfileResult
+{
+	int env_count = 0;
+	// The wall time of the run
+	double duration = 0;
+	uint64_t steps = 0;
+	uint64_t frames = 0;
+	double emulation = 0;
+	double preprocessing = 0;
+	double reset = 0;
+	double callbacks = 0;
+	// Choosing actions. When running the agent's model this is the time each environment waited for its actions up to
+	// its last step, including any agent overhead.
+	double policy = 0;
+	// The remaining time, such as environments which finished their steps waiting for the others
+	double other = 0;
+	bool policy_measured = false;
+};
+
+/// @brief Forwards callbacks to another callback, measuring the time spent in them and counting the steps of each
+/// environment. start() must be called before the agent runs.
+class ProfileCallback : public drla::AgentCallbackInterface
+{
+public:
+	/// @param callback The callback to forward to, or null to only count steps
+	explicit ProfileCallback(drla::AgentCallbackInterface* callback = nullptr);
+
+	/// @brief Sets the callback to forward to
+	void set_callback(drla::AgentCallbackInterface* callback);
+
+	/// @brief Starts profiling a run, clearing the measurements of any previous run
+	/// @param env_count The number of environments the agent runs
+	/// @param step_limit When > 0 each environment is stopped after this many steps, continuing into a new episode when
+	/// an episode ends before then. When 0 the forwarded callback decides when to stop.
+	void start(int env_count, int step_limit);
+
+	/// @brief The total time spent in the forwarded callbacks in seconds
+	double callback_time() const;
+
+	/// @brief The time from start() to the end of each environment's last step, summed over the environments, in seconds
+	double env_time() const;
+
+	void train_init(const drla::InitData& data) override;
+	drla::AgentResetConfig env_reset(const drla::StepData& data) override;
+	bool env_step(const drla::StepData& data) override;
+	void train_update(const drla::TrainUpdateData& data) override;
+	torch::Tensor interactive_step() override;
+	void save(int steps, const std::filesystem::path& path) override;
+
+private:
+	// Only accessed by the thread stepping the environment
+	struct EnvProgress
+	{
+		int steps = 0;
+		std::chrono::steady_clock::time_point last_step;
+	};
+
+	drla::AgentCallbackInterface* callback_;
+	std::atomic<uint64_t> callback_ns_ = 0;
+	int step_limit_ = 0;
+	std::chrono::steady_clock::time_point start_;
+	std::vector<EnvProgress> envs_;
+};
+
+/// @brief Profiles a run of the agent, with each environment assumed to be stepped by its own thread. The time each
+/// environment spent up to its last step, not in the environment or callbacks, is attributed to the policy. The time
+/// after its last step, while the other environments finish, is not.
+/// @param callback The callback the agent runs with
+/// @param env_count The number of environments the agent runs
+/// @param step_limit When > 0 the number of steps each environment runs, continuing through the ends of episodes
+/// @param run Runs the agent
+/// @return Where the time was spent
+ProfileResult profile_agent(
+	ProfileCallback& callback, int env_count, int step_limit, const std::function<void()>& run);
+
+/// @brief Profiles stepping environments without the agent, each on its own thread
+/// @param config The environment configuration
+/// @param env_count The number of environments to run
+/// @param steps The number of steps each environment performs
+/// @param policy The policy choosing actions, either random or fixed
+/// @return Where the time was spent
+ProfileResult profile_policy(const Config::AtariEnv& config, int env_count, int steps, ProfilePolicy policy);
+
+/// @brief The environment counts to sweep when none are specified, the powers of two up to the number of hardware
+/// threads
+std::vector<int> default_profile_env_counts();
+
+/// @brief Parses a comma separated list of environment counts, using the default counts when empty
+std::vector<int> parse_profile_env_counts(const std::string& env_counts);
+
+/// @brief Parses a profile policy from its name, "model", "random" or "fixed"
+ProfilePolicy parse_profile_policy(const std::string& policy);
+
+/// @brief Prints a table of the throughput and time breakdown of each run, and the throughput knee: the fewest
+/// environments reaching 90% of the peak throughput
+void print_profile(const std::vector<ProfileResult>& results);
+
+} // namespace atari
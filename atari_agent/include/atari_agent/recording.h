@@ -0,0 +1,44 @@
+#pragma once
+
+#include "atari_agent/configuration.h"
+
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+namespace atari
+{
+
+/// @brief A game recorded as the emulator state it started from and the actions taken, which is enough to re-emulate
+/// it exactly. This is a few bytes per step, rather than the frames themselves.
+struct EpisodeRecording
+{
+	// The MD5 hash of the ROM, which must match the ROM the game is replayed with
+	std::string rom_md5;
+	// The environment configuration the game was recorded with
+	Config::AtariEnv env;
+	// The emulator settings which affect emulation
+	int game_seed = 0;
+	float repeat_action_probability = 0;
+	// The serialised emulator state, including its random number generator, from before the game was reset
+	std::string start_state;
+	// The number of noop frames performed after resetting the game
+	int noop_frames = 0;
+	// The index of the action in the environment's action set taken at each step
+	std::vector<uint8_t> actions;
+	// The total unclipped reward of the game, used to check a replay matches the recording
+	float score = 0;
+};
+
+/// @brief Saves a recording as CBOR
+/// @param path The path of the recording file
+/// @param recording The recording to save
+void save_recording(const std::filesystem::path& path, const EpisodeRecording& recording);
+
+/// @brief Loads a recording saved by save_recording
+/// @param path The path of the recording file
+/// @return The recording
+EpisodeRecording load_recording(const std::filesystem::path& path);
+
+} // namespace atari
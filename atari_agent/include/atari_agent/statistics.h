@@ -0,0 +1,21 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+namespace atari
+{
+
+/// @brief Counters of events across all environments in the process. The counters can be read from any thread.
+struct EnvStatistics
+{
+	// The number of resets which swapped in a game started ahead of time
+	std::atomic<uint64_t> reset_ahead_ready{0};
+	// The number of resets which had to wait for the background thread to finish starting the next game
+	std::atomic<uint64_t> reset_ahead_blocked{0};
+};
+
+/// @brief The statistics of all environments in the process
+EnvStatistics& env_statistics();
+
+} // namespace atari
@@ -0,0 +1,98 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <filesystem>
+#include <mutex>
+#include <thread>
+
+namespace atari
+{
+
+/// @brief Records the spans of all threads within a time window, then writes them to a Chrome trace event JSON file
+/// which can be opened in Perfetto or chrome://tracing. Only one recorder can be created per process.
+///
+/// Each thread appends its spans to a linear array of 64k spans, not a ring buffer. Once a thread's array is full its
+/// later spans are dropped, and the number dropped is logged when the trace is written.
+class TraceRecorder
+{
+public:
+	/// @brief Starts a background thread which opens the window after the delay and writes the trace once it closes
+	/// @param path The path of the trace file
+	/// @param delay The time in seconds from construction until recording starts
+	/// @param duration The time in seconds to record for
+	TraceRecorder(std::filesystem::path path, double delay, double duration);
+
+	/// @brief Closes the window early if it is still open and writes the trace
+	~TraceRecorder();
+
+	TraceRecorder(const TraceRecorder&) = delete;
+	TraceRecorder& operator=(const TraceRecorder&) = delete;
+
+private:
+	void run(std::chrono::steady_clock::time_point start, std::chrono::steady_clock::duration duration);
+	void write() const;
+
+	const std::filesystem::path path_;
+
+	std::mutex m_stop_;
+	std::condition_variable cv_stop_;
+	bool stop_ = false;
+	std::thread thread_;
+};
+
+/// @brief True while a trace window is open
+bool is_tracing();
+
+/// @brief Adds a span to the calling thread's trace events, if a trace window is open
+/// @param name The name of the span. Must be a string literal, as only the pointer is stored.
+/// @param category The category of the span. Must be a string literal.
+/// @param start_ns The steady clock time the span started in nanoseconds
+/// @param end_ns The steady clock time the span ended in nanoseconds
+void trace_event(const char* name, const char* category, int64_t start_ns, int64_t end_ns);
+
+/// @brief Records the span from construction to destruction. Only the open check is performed when not tracing, so
+/// spans are only recorded if the window was open when they began and is still open when they end.
+class TraceScope
+{
+public:
+	TraceScope(const char* name, const char* category) : name_(is_tracing() ? name : nullptr), category_(category)
+	{
+		if (name_ != nullptr)
+		{
+			start_ns_ = now_ns();
+		}
+	}
+
+	~TraceScope()
+	{
+		if (name_ != nullptr)
+		{
+			trace_event(name_, category_, start_ns_, now_ns());
+		}
+	}
+
+	TraceScope(const TraceScope&) = delete;
+	TraceScope& operator=(const TraceScope&) = delete;
+
+private:
+	static int64_t now_ns()
+	{
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(
+						 std::chrono::steady_clock::now().time_since_epoch())
+			.count();
+	}
+
+	const char* const name_;
+	const char* const category_;
+	int64_t start_ns_ = 0;
+};
+
+} // namespace atari
+
+#define ATARI_TRACE_CONCAT_IMPL(a, b) a##b
+#define ATARI_TRACE_CONCAT(a, b) ATARI_TRACE_CONCAT_IMPL(a, b)
+/// @brief Traces the rest of the enclosing scope as a span
+#define ATARI_TRACE_SCOPE(name, category) \
+	const ::atari::TraceScope ATARI_TRACE_CONCAT(trace_scope_, __LINE__)(name, category)
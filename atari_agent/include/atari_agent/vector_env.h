@@ -0,0 +1,122 @@
+#pragma once
+
+#include "atari_agent/configuration.h"
+
+#include <drla/environment.h>
+#include <torch/torch.h>
+
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace atari
+{
+
+class Atari;
+class ThreadPool;
+
+/// @brief The batched output of stepping or resetting environments in a vector environment. The tensors are views into
+/// a single contiguous allocation made for each step.
+struct VectorStepData
+{
+	// The id of the environment for each entry in the batch, [B]
+	torch::Tensor env_id;
+	// The stacked observations of each environment, [B, C, H, W] for pixels or [B, S * 128] for RAM
+	torch::Tensor observation;
+	// The reward of each environment, [B]
+	torch::Tensor reward;
+	// Indicates the episode ended for each environment, [B]. Environments are reset automatically when their episode
+	// ends, so the observation is the first of the next episode.
+	torch::Tensor episode_end;
+};
+
+/// @brief The size of a vector environment and the threads stepping it
+struct VectorEnvOptions
+{
+	// The number of environments (N)
+	int env_count = 1;
+	// The number of completed environments (M) returned from each asynchronous receive. Values <= 0 or >= env_count
+	// return every environment.
+	int batch_size = 0;
+	// The number of worker threads stepping the environments, limited to the number of environments. Values <= 0 use the
+	// number of hardware threads.
+	int thread_count = 0;
+	// The maximum number of steps per episode. 0 implies no limit.
+	int max_episode_steps = 0;
+};
+
+/// @brief Owns N Atari environments and steps them in parallel on a pool of worker threads, returning batched results.
+/// Each environment is always stepped by the same worker.
+///
+/// Environments can be stepped synchronously via step(), or asynchronously via send() and recv(), which returns the
+/// first M environments to complete. Asynchronous stepping lets a caller run inference on a completed batch while the
+/// other environments are still emulating. The two modes should not be mixed while asynchronous steps are pending.
+///
+/// This is a library API for callers which batch their own inference, such as atari_bench. The agents of atari_train
+/// and atari_run step their Atari environments individually via drla, so use neither mode.
+class AtariVectorEnv
+{
+public:
+	/// @brief Creates the environments and worker threads
+	/// @param config The configuration for each environment
+	/// @param options The number of environments (N), the asynchronous batch size (M) and the number of worker threads
+	AtariVectorEnv(const Config::AtariEnv& config, const VectorEnvOptions& options);
+	~AtariVectorEnv();
+
+	/// @brief Resets all environments
+	/// @return The initial observations, with zero rewards and no episode ends
+	VectorStepData reset();
+
+	/// @brief Steps all environments with the supplied actions
+	/// @param actions The index of the action to perform for each environment, [N]
+	/// @return The batched step results, ordered by env id
+	VectorStepData step(const torch::Tensor& actions);
+
+	/// @brief Asynchronously resets all environments. The initial observations are returned via recv().
+	void async_reset();
+
+	/// @brief Submits actions for a subset of environments to be stepped asynchronously. The results are returned via
+	/// recv(). An environment must have been received before it is sent another action.
+	/// @param actions The index of the action to perform for each environment in env_ids, [K]
+	/// @param env_ids The ids of the environments to step, [K]
+	void send(const torch::Tensor& actions, const torch::Tensor& env_ids);
+
+	/// @brief Blocks until batch_size() environments have completed their asynchronous step or reset.
+	/// @return The batched results of the completed environments, in order of completion
+	VectorStepData recv();
+
+	/// @brief The number of environments (N)
+	int size() const;
+
+	/// @brief The number of environments (M) returned by recv()
+	int batch_size() const;
+
+	/// @brief The configuration of each environment
+	drla::EnvironmentConfiguration get_configuration() const;
+
+private:
+	void submit(int env_id, int action);
+	VectorStepData allocate_step_data(int count) const;
+
+	const Config::AtariEnv config_;
+	const int max_episode_steps_;
+	std::vector<std::unique_ptr<Atari>> envs_;
+	std::unique_ptr<ThreadPool> thread_pool_;
+	std::vector<int64_t> observation_shape_;
+	torch::ScalarType observation_dtype_;
+	int batch_size_;
+
+	// The latest asynchronous results of each environment
+	torch::Tensor env_observations_;
+	std::vector<torch::Tensor> env_observation_slots_;
+	std::vector<float> env_rewards_;
+	std::vector<char> env_episode_ends_;
+	std::vector<char> env_pending_;
+
+	std::mutex m_completed_;
+	std::condition_variable cv_completed_;
+	std::vector<int> completed_;
+};
+
+} // namespace atari
@@ -0,0 +1,54 @@
+#include "affinity.h"
+
+#include <spdlog/spdlog.h>
+
+#include <atomic>
+#include <cstring>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+using namespace atari;
+
+const std::vector<int>& atari::env_cpu_set(const Config::AtariEnv& config, int env_index)
+{
+	static const std::vector<int> unpinned;
+	if (config.cpu_affinity.empty())
+	{
+		return unpinned;
+	}
+	return config.cpu_affinity[static_cast<size_t>(env_index) % config.cpu_affinity.size()];
+}
+
+void atari::pin_thread(const std::vector<int>& cpus)
+{
+	if (cpus.empty())
+	{
+		return;
+	}
+#ifdef __linux__
+	cpu_set_t cpu_set;
+	CPU_ZERO(&cpu_set);
+	for (int cpu : cpus)
+	{
+		if (cpu < 0 || cpu >= CPU_SETSIZE)
+		{
+			spdlog::warn("Unable to pin a thread to CPU {}, which is out of range", cpu);
+			continue;
+		}
+		CPU_SET(cpu, &cpu_set);
+	}
+	if (int error = pthread_setaffinity_np(pthread_self(), sizeof(cpu_set), &cpu_set); error != 0)
+	{
+		spdlog::warn("Unable to pin a thread to its CPU set: {}", std::strerror(error));
+	}
+#else
+	static std::atomic<bool> warned = false;
+	if (!warned.exchange(true))
+	{
+		spdlog::warn("Pinning threads to CPUs is only supported on Linux");
+	}
+#endif
+}
@@ -0,0 +1,22 @@
+#pragma once
+
+#include "configuration.h"
+
+#include <vector>
+
+namespace atari
+{
+
+/// @brief The CPUs the threads of an environment are pinned to
+/// @param config The environment configuration
+/// @param env_index The index of the environment
+/// @return The environment's CPU set, which is empty when threads aren't pinned
+const std::vector<int>& env_cpu_set(const Config::AtariEnv& config, int env_index);
+
+/// @brief Restricts the calling thread to a set of CPUs. On Linux memory is allocated on the NUMA node of the thread
+/// which first touches it, so pinning a thread before it allocates an environment's buffers keeps them local. Failures
+/// are logged, as pinning only affects performance.
+/// @param cpus The CPUs the thread can run on. Empty leaves the thread unpinned.
+void pin_thread(const std::vector<int>& cpus);
+
+} // namespace atari
@@ -1,8 +1,16 @@
 #include "atari_agent.h"
 
+#include "affinity.h"
 #include "atari_env.h"
+#include "thread_pool.h"
 
+#include <spdlog/spdlog.h>
+
+#include <algorithm>
+#include <chrono>
+#include <exception>
 #include <iostream>
+#include <thread>
 
 using namespace atari;
 
@@ -18,7 +26,10 @@ AtariAgent::~AtariAgent()
 
 void AtariAgent::train()
 {
+	prepare_environments(std::visit([](const auto& agent) { return agent.env_count; }, config_.agent));
 	agent_->train();
+	std::lock_guard lock(m_envs_);
+	prepared_envs_.clear();
 }
 
 void AtariAgent::stop_train()
@@ -26,17 +37,88 @@ void AtariAgent::stop_train()
 	agent_->stop_train();
 }
 
-void AtariAgent::run(int env_count, drla::RunOptions options)
+void AtariAgent::run(int env_count, drla::RunOptions options, int seed)
 {
 	std::vector<drla::State> initial_states;
 	initial_states.resize(env_count);
-	for (auto& state : initial_states) { state.max_episode_steps = options.max_steps; }
+	for (int i = 0; i < env_count; ++i)
+	{
+		auto& state = initial_states[i];
+		state.max_episode_steps = options.max_steps;
+		if (seed >= 0)
+		{
+			state.env_state = std::make_any<EnvState>(EnvState{0, seed + i});
+		}
+	}
+	prepare_environments(env_count);
 	agent_->run(initial_states, std::move(options));
+	std::lock_guard lock(m_envs_);
+	prepared_envs_.clear();
 }
 
 std::unique_ptr<drla::Environment> AtariAgent::make_environment()
 {
-	return std::make_unique<Atari>(config_.env);
+	std::lock_guard lock(m_envs_);
+	if (!prepared_envs_.empty())
+	{
+		auto env = std::move(prepared_envs_.front());
+		prepared_envs_.pop_front();
+		return env;
+	}
+	return std::make_unique<Atari>(config_.env, next_env_index_++);
+}
+
+void AtariAgent::prepare_environments(int env_count)
+{
+	if (env_count <= 0)
+	{
+		return;
+	}
+	int first_index = 0;
+	{
+		std::lock_guard lock(m_envs_);
+		first_index = next_env_index_;
+		next_env_index_ += env_count;
+	}
+
+	// Creating an environment loads the ROM and starts the emulator, which is slow enough to dominate startup with many
+	// environments when done one after another
+	const auto start = std::chrono::steady_clock::now();
+	int thread_count = config_.env.construction_thread_count;
+	if (thread_count <= 0)
+	{
+		thread_count = static_cast<int>(std::thread::hardware_concurrency());
+	}
+	thread_count = std::clamp(thread_count, 1, env_count);
+	std::vector<std::unique_ptr<drla::Environment>> envs(env_count);
+	std::vector<std::exception_ptr> errors(env_count);
+	{
+		ThreadPool pool(thread_count);
+		pool.parallel_for(env_count, [&](int i) {
+			try
+			{
+				// The environment's memory is allocated on the NUMA node of the thread creating it
+				pin_thread(env_cpu_set(config_.env, first_index + i));
+				envs[i] = std::make_unique<Atari>(config_.env, first_index + i);
+			}
+			catch (...)
+			{
+				errors[i] = std::current_exception();
+			}
+		});
+	}
+	for (auto& error : errors)
+	{
+		if (error)
+		{
+			std::rethrow_exception(error);
+		}
+	}
+	const std::chrono::duration<double> duration = std::chrono::steady_clock::now() - start;
+	spdlog::info("Created {} environments in {:.2f}s using {} threads", env_count, duration.count(), thread_count);
+
+	std::lock_guard lock(m_envs_);
+	for (auto& env : envs) { prepared_envs_.push_back(std::move(env)); }
 }
 
 drla::State AtariAgent::get_initial_state()
@@ -1,81 +1,333 @@
 #include "atari_env.h"
 
+#include "affinity.h"
+#include "perf.h"
+#include "recording.h"
+#include "statistics.h"
+#include "thread_pool.h"
+#include "trace.h"
+
 #include <spdlog/spdlog.h>
-#include <torch/nn/functional.h>
 
 #include <algorithm>
+#include <cstring>
 #include <filesystem>
+#include <limits>
+#include <numeric>
+#include <stdexcept>
+
+#ifdef __linux__
+#include <sys/resource.h>
+#endif
 
 using namespace atari;
 
-Atari::Atari(const Config::AtariEnv& config) : config_(config)
+namespace
+{
+
+// A tensor can be reused to return new data only when nothing else holds a reference to it or its storage, such as a
+// callback retaining step data from a previous step
+bool is_unshared(const torch::Tensor& tensor)
+{
+	return tensor.defined() && tensor.use_count() == 1 && tensor.storage().use_count() == 1;
+}
+
+// Returns the tensor to write a step's data to. The current tensor is reused when nothing else references it. The
+// caller usually still holds the previous step's data, so otherwise the spare tensor from the step before is reused,
+// which is only reallocated when that is also still referenced.
+torch::Tensor& reusable_tensor(
+	torch::Tensor& current, torch::Tensor& spare, c10::IntArrayRef shape, const torch::TensorOptions& options)
+{
+	if (!is_unshared(current))
+	{
+		std::swap(current, spare);
+		if (!is_unshared(current))
+		{
+			current = torch::empty(shape, options);
+		}
+	}
+	return current;
+}
+
+// The low priority background thread shared by all environments to start their spare games. The thread exists only
+// while an environment uses it.
+std::shared_ptr<ThreadPool> get_reset_ahead_thread()
 {
+	static std::mutex m_thread;
+	static std::weak_ptr<ThreadPool> shared_thread;
+	std::lock_guard lock(m_thread);
+	auto thread = shared_thread.lock();
+	if (!thread)
+	{
+		thread = std::make_shared<ThreadPool>(1);
+#ifdef __linux__
+		// Linux applies the nice value to the calling thread only, so this lowers the priority of the pool's thread
+		thread->submit(0, [] { setpriority(PRIO_PROCESS, 0, 19); });
+#endif
+		shared_thread = thread;
+	}
+	return thread;
+}
+
+} // namespace
+
+Atari::Atari(const Config::AtariEnv& config, int env_index)
+		: config_(config)
+		, env_index_(env_index)
+		, rom_(validate_rom(config_.rom_file))
+		, cpu_set_(env_cpu_set(config_, env_index))
+{
+	if (config_.record_episodes && config_.reset_state_bank_size > 0)
+	{
+		spdlog::error("Recording episodes is not supported with the reset state bank");
+		throw std::invalid_argument("Unsupported environment configuration");
+	}
+	seed_ = config_.seed >= 0 ? config_.seed + env_index : static_cast<int>(std::random_device{}() & 0x7FFFFFFF);
+	seed_rng_.seed(seed_);
+	create_game(game_, next_game_seed());
+	reset_rng_.seed(seed_rng_());
+
+	// Get the vector of minimal actions. The legal actions are always the full minimal action set, so are only
+	// determined once.
+	action_set_ = game_.emulator->getMinimalActionSet();
+	legal_actions_.resize(action_set_.size());
+	std::iota(legal_actions_.begin(), legal_actions_.end(), 0);
+
+	pool_buffer_.resize(game_.preprocessor->screen_size());
+
+	snapshot_pool_ = std::make_shared<SnapshotPool>();
+	if (config_.reset_state_bank_size > 0)
+	{
+		reset_state_bank_.resize(std::min(config_.reset_state_bank_size, std::max(config_.noop_reset_max_frames, 0) + 1));
+	}
+	else if (config_.reset_ahead)
+	{
+		spare_game_ = std::make_unique<Game>();
+		create_game(*spare_game_, next_game_seed());
+		reset_ahead_thread_ = get_reset_ahead_thread();
+		prepare_spare_game();
+	}
+
+	observations_.resize(config_.observation_mode == Config::ObservationMode::kPixelsAndRAM ? 2 : 1);
+	spare_observations_.resize(observations_.size());
+}
+
+Atari::~Atari()
+{
+	// The background thread may still be starting the spare game, which must finish before it is destroyed
+	if (spare_game_)
+	{
+		std::unique_lock lock(m_spare_game_);
+		cv_spare_game_.wait(lock, [this] { return spare_game_ready_; });
+	}
+}
+
+void Atari::create_game(Game& game, int seed) const
+{
+	game.emulator = std::make_unique<ale::ALEInterface>();
+	game.seed = seed;
+	// Settings only take effect when the ROM is loaded
+	game.emulator->setInt("random_seed", seed);
 	// Load the ROM file. (Also resets the system for new settings to take effect.)
-	ale_.loadROM(std::filesystem::current_path() / config_.rom_file);
+	game.emulator->loadROM(rom_.path);
+
+	const auto& screen = game.emulator->getScreen();
+	game.preprocessor = std::make_unique<FramePreprocessor>(config_, int(screen.height()), int(screen.width()));
+	game.screen_buffer.resize(game.preprocessor->screen_size());
+	const auto dtype = config_.use_float ? torch::kFloat : torch::kByte;
+	if (config_.observation_mode != Config::ObservationMode::kRAM)
+	{
+		game.frame_stack = std::make_unique<FrameStack>(config_.frame_stack, game.preprocessor->frame_shape(), dtype);
+	}
+	if (config_.observation_mode != Config::ObservationMode::kPixels)
+	{
+		const std::vector<int64_t> ram_shape = {static_cast<int64_t>(game.emulator->getRAM().size())};
+		game.ram_stack = std::make_unique<FrameStack>(config_.frame_stack, ram_shape, dtype);
+	}
+}
 
-	// Get the vector of minimal actions
-	action_set_ = ale_.getMinimalActionSet();
-	int i = 0;
-	for (auto action : action_set_) { action_index_.emplace(action, i++); }
+int Atari::next_game_seed()
+{
+	return std::uniform_int_distribution<int>(0, std::numeric_limits<int>::max())(seed_rng_);
+}
 
-	observations_.resize(1);
+void Atari::reseed(int seed)
+{
+	// Recreates the games in the same order as construction, so a reseeded environment matches a new one
+	seed_ = seed;
+	seed_rng_.seed(seed_);
+	create_game(game_, next_game_seed());
+	reset_rng_.seed(seed_rng_());
+	// The cached start states were captured with the previous seed
+	for (auto& start_state : reset_state_bank_) { start_state.reset(); }
+	// The new game is yet to be started, so the next restart must start it rather than continue after a life loss
+	state_.lives = 0;
+	if (spare_game_)
+	{
+		recreate_spare_game();
+	}
+}
+
+void Atari::recreate_spare_game()
+{
+	// The spare game may still be starting on the background thread
+	{
+		std::unique_lock lock(m_spare_game_);
+		cv_spare_game_.wait(lock, [this] { return spare_game_ready_; });
+		spare_game_ready_ = false;
+	}
+	create_game(*spare_game_, next_game_seed());
+	prepare_spare_game();
 }
 
 int Atari::single_step(ale::Action action)
 {
-	auto reward = ale_.act(action);
+	ATARI_PERF_SCOPE(PerfStage::kEmulation);
+	auto reward = game_.emulator->act(action);
 
-	int lives = ale_.lives();
+	int lives = game_.emulator->lives();
 	if (config_.end_episode_on_life_loss)
 	{
 		episode_end_ |= lives < state_.lives;
 	}
 	state_.lives = lives;
-	episode_end_ |= ale_.game_over();
+	episode_end_ |= game_.emulator->game_over();
 
 	return reward;
 }
 
 drla::EnvStepData Atari::step(torch::Tensor action)
 {
-	ale::Action a = action_set_[action[0].item<int>()];
-	torch::Tensor reward = torch::zeros(1);
+	ATARI_TRACE_SCOPE("step", "env");
+	pin_stepping_thread();
+	float reward = advance(action.item<int>());
+
+	write_observations();
+	reusable_tensor(reward_, spare_reward_, {1}, torch::kFloat).data_ptr<float>()[0] = reward;
+
+	// The result is the only allocation left in a step. drla::EnvStepData copies the observation and legal action vectors,
+	// and the EnvState is allocated by std::any, as holding the recording makes it too large for the small object buffer.
+	return {
+		observations_, reward_, {std::make_any<EnvState>(state_), step_, episode_end_, max_episode_steps_}, legal_actions_};
+}
+
+// This is performed after a step but before the next step
+drla::EnvStepData Atari::reset(const drla::State& initial_state)
+{
+	ATARI_TRACE_SCOPE("reset", "env");
+	pin_stepping_thread();
+	const auto* initial_env_state = std::any_cast<EnvState>(&initial_state.env_state);
+	if (initial_env_state != nullptr && initial_env_state->seed >= 0 && initial_env_state->seed != seed_)
+	{
+		reseed(initial_env_state->seed);
+	}
+	if (!restart(initial_state.max_episode_steps))
+	{
+		write_observations();
+		return {
+			observations_,
+			torch::zeros(1),
+			{std::make_any<EnvState>(state_), step_, episode_end_, max_episode_steps_},
+			legal_actions_};
+	}
+
+	write_observations();
+
+	return {observations_, torch::zeros(1), {std::make_any<EnvState>(state_), step_, episode_end_}, legal_actions_};
+}
+
+float Atari::step(int action, torch::Tensor observation)
+{
+	ATARI_TRACE_SCOPE("step", "env");
+	float reward = advance(action);
+	ATARI_PERF_SCOPE(PerfStage::kObservation);
+	observation_stack().write(observation);
+	return reward;
+}
+
+void Atari::reset(int max_episode_steps, torch::Tensor observation)
+{
+	ATARI_TRACE_SCOPE("reset", "env");
+	restart(max_episode_steps);
+	ATARI_PERF_SCOPE(PerfStage::kObservation);
+	observation_stack().write(observation);
+}
+
+bool Atari::is_episode_end() const
+{
+	return episode_end_;
+}
+
+const std::vector<int64_t>& Atari::observation_shape() const
+{
+	return observation_stack().stacked_shape();
+}
+
+torch::ScalarType Atari::observation_dtype() const
+{
+	return config_.use_float ? torch::kFloat : torch::kByte;
+}
+
+float Atari::advance(int action)
+{
+	ATARI_PERF_SCOPE(PerfStage::kStep);
+	ale::Action a = action_set_[action];
+	float reward = 0.0F;
+	auto* frame_stack = game_.frame_stack.get();
 
 	if (config_.frame_skip > 1)
 	{
-		reward[0] = 0.0F;
-		std::vector<torch::Tensor> max_buffer;
-		max_buffer.resize(2);
 		for (int f = 0; f < config_.frame_skip; f++)
 		{
-			reward[0] += single_step(a);
+			reward += single_step(a);
+			if (frame_stack == nullptr)
+			{
+				continue;
+			}
 
+			// Max pool the raw screens of the last two frames, so preprocessing is only performed once
 			if (f == config_.frame_skip - 2)
 			{
-				max_buffer[0] = get_observation();
+				capture_screen(*game_.emulator, pool_buffer_);
 			}
 			else if (f == config_.frame_skip - 1)
 			{
-				max_buffer[1] = get_observation();
+				capture_screen(*game_.emulator, game_.screen_buffer);
 			}
 		}
-		buffer_.push_back(max_buffer[0].max(max_buffer[1]));
+		if (frame_stack != nullptr)
+		{
+			ATARI_PERF_SCOPE(PerfStage::kPreprocess);
+			game_.preprocessor->max_pool(pool_buffer_.data(), game_.screen_buffer.data());
+			game_.preprocessor->process(game_.screen_buffer.data(), frame_stack->next_slot());
+			frame_stack->push();
+		}
 	}
 	else
 	{
-		reward[0] = single_step(a);
-		buffer_.push_back(get_observation());
+		reward = single_step(a);
+		if (frame_stack != nullptr)
+		{
+			capture_screen(*game_.emulator, game_.screen_buffer);
+			ATARI_PERF_SCOPE(PerfStage::kPreprocess);
+			game_.preprocessor->process(game_.screen_buffer.data(), frame_stack->next_slot());
+			frame_stack->push();
+		}
+	}
+	if (game_.ram_stack)
+	{
+		capture_ram(*game_.emulator, *game_.ram_stack);
 	}
 
-	if (static_cast<int>(buffer_.size()) > config_.frame_stack)
+	if (recording_)
 	{
-		buffer_.erase(buffer_.begin());
+		recording_->actions.push_back(static_cast<uint8_t>(action));
+		recording_->score += reward;
 	}
-	observations_[0] = torch::cat(buffer_);
 
 	if (config_.clip_reward)
 	{
-		reward[0].sign_();
+		reward = static_cast<float>((reward > 0.0F) - (reward < 0.0F));
 	}
 
 	++step_;
@@ -84,115 +336,316 @@ drla::EnvStepData Atari::step(torch::Tensor action)
 		episode_end_ = true;
 	}
 
-	return {
-		observations_,
-		reward,
-		{std::make_any<EnvState>(state_), step_, episode_end_, max_episode_steps_},
-		get_legal_actions()};
+	// The game is complete when the next reset will start a new game
+	if (recording_ && episode_end_ && !(config_.end_episode_on_life_loss && state_.lives > 0))
+	{
+		state_.recording = std::move(recording_);
+	}
+
+	return reward;
 }
 
-// This is performed after a step but before the next step
-drla::EnvStepData Atari::reset(const drla::State& initial_state)
+bool Atari::restart(int max_episode_steps)
 {
+	ATARI_PERF_SCOPE(PerfStage::kReset);
+	state_.recording.reset();
 	step_ = 0;
 	episode_end_ = false;
-	max_episode_steps_ = initial_state.max_episode_steps;
+	max_episode_steps_ = max_episode_steps;
 	if (config_.end_episode_on_life_loss && state_.lives > 0)
 	{
-		return {
-			observations_,
-			torch::zeros(1),
-			{std::make_any<EnvState>(state_), step_, episode_end_, max_episode_steps_},
-			get_legal_actions()};
+		return false;
 	}
 
-	ale_.reset_game();
+	if (spare_game_)
+	{
+		swap_spare_game();
+		begin_recording();
+		return true;
+	}
+	if (reset_state_bank_.empty())
+	{
+		start_game(game_, config_.noop_reset_max_frames);
+		state_.lives = game_.lives;
+		begin_recording();
+		return true;
+	}
 
-	state_.lives = ale_.lives();
+	std::uniform_int_distribution<size_t> dist(0, reset_state_bank_.size() - 1);
+	size_t index = dist(reset_rng_);
+	auto& start_state = reset_state_bank_[index];
+	if (start_state)
+	{
+		restore(*start_state);
+		max_episode_steps_ = max_episode_steps;
+	}
+	else
+	{
+		// Spread the noop counts of the bank evenly over [0, noop_reset_max_frames], with the first entry matching a reset
+		// without the bank
+		const int noop_range = std::max(config_.noop_reset_max_frames, 0) + 1;
+		const int noop_frames =
+			config_.noop_reset_max_frames - static_cast<int>(index) * noop_range / int(reset_state_bank_.size());
+		start_game(game_, noop_frames);
+		state_.lives = game_.lives;
+		// The emulator's random number generator is left running when restored, so sticky actions differ between games
+		start_state = snapshot(false);
+	}
 
-	buffer_.clear();
-	for (int f = config_.noop_reset_max_frames; f > 0; f--)
+	return true;
+}
+
+void Atari::start_game(Game& game, int noop_frames) const
+{
+	if (config_.record_episodes)
+	{
+		// Includes the random number generator, which determines the reset and sticky actions
+		game.start_state = game.emulator->cloneState(true).serialize();
+		game.noop_frames = noop_frames;
+	}
+	game.emulator->reset_game();
+
+	for (auto* stack : {game.frame_stack.get(), game.ram_stack.get()})
+	{
+		if (stack != nullptr)
+		{
+			stack->clear();
+		}
+	}
+	for (int f = noop_frames; f > 0; f--)
 	{
 		if (f < config_.frame_stack)
 		{
-			buffer_.push_back(get_observation());
+			push_frame(game);
 		}
-		ale_.act(ale::PLAYER_A_NOOP);
+		game.emulator->act(ale::PLAYER_A_NOOP);
 	}
+	push_frame(game);
 
-	while (static_cast<int>(buffer_.size()) < config_.frame_stack) { buffer_.push_back(get_observation()); }
+	for (auto* stack : {game.frame_stack.get(), game.ram_stack.get()})
+	{
+		if (stack != nullptr)
+		{
+			stack->fill();
+		}
+	}
+	game.lives = game.emulator->lives();
+}
+
+void Atari::push_frame(Game& game) const
+{
+	if (game.frame_stack)
+	{
+		capture_screen(*game.emulator, game.screen_buffer);
+		game.preprocessor->process(game.screen_buffer.data(), game.frame_stack->next_slot());
+		game.frame_stack->push();
+	}
+	if (game.ram_stack)
+	{
+		capture_ram(*game.emulator, *game.ram_stack);
+	}
+}
+
+void Atari::swap_spare_game()
+{
+	std::unique_lock lock(m_spare_game_);
+	if (spare_game_ready_)
+	{
+		env_statistics().reset_ahead_ready++;
+	}
+	else
+	{
+		env_statistics().reset_ahead_blocked++;
+		cv_spare_game_.wait(lock, [this] { return spare_game_ready_; });
+	}
+	std::swap(game_, *spare_game_);
+	state_.lives = game_.lives;
+	spare_game_ready_ = false;
+	lock.unlock();
 
-	observations_[0] = torch::cat(buffer_);
+	// The finished game is started again in the background, ready for the next reset
+	prepare_spare_game();
+}
 
-	return {observations_, torch::zeros(1), {std::make_any<EnvState>(state_), step_, episode_end_}, get_legal_actions()};
+void Atari::prepare_spare_game()
+{
+	reset_ahead_thread_->submit(0, [this]() {
+		start_game(*spare_game_, config_.noop_reset_max_frames);
+		// Notify while holding the lock, as the environment may be destroyed as soon as it sees the game is ready
+		std::lock_guard lock(m_spare_game_);
+		spare_game_ready_ = true;
+		cv_spare_game_.notify_one();
+	});
 }
 
 drla::Observations Atari::get_visualisations()
 {
-	std::vector<unsigned char> output_buffer;
-	const auto& screen = ale_.getScreen();
-	ale_.getScreenRGB(output_buffer);
-	return {torch::from_blob(output_buffer.data(), {int(screen.height()), int(screen.width()), 3}, torch::kByte).clone()};
+	ATARI_PERF_SCOPE(PerfStage::kVisualisation);
+	ATARI_TRACE_SCOPE("visualisations", "env");
+	const auto& screen = game_.emulator->getScreen();
+	if (!config_.indexed_visualisations)
+	{
+		game_.emulator->getScreenRGB(rgb_buffer_);
+		return {torch::from_blob(rgb_buffer_.data(), {int(screen.height()), int(screen.width()), 3}, torch::kByte).clone()};
+	}
+
+	auto indices = torch::empty({int(screen.height()), int(screen.width())}, torch::kByte);
+	auto* data = indices.data_ptr<uint8_t>();
+	std::memcpy(data, screen.getArray(), indices.numel());
+	update_palette(data, indices.numel());
+	return {indices, palette_};
+}
+
+void Atari::update_palette(const uint8_t* indices, size_t count)
+{
+	auto is_known = [this](uint8_t index) { return palette_known_[index]; };
+	if (palette_.defined() && std::all_of(indices, indices + count, is_known))
+	{
+		return;
+	}
+
+	// The colours of new palette indices are looked up from the RGB screen. A new palette is created rather than
+	// modifying the existing one, as previous visualisations may still be using it.
+	game_.emulator->getScreenRGB(rgb_buffer_);
+	auto palette = palette_.defined() ? palette_.clone() : torch::zeros({256, 3}, torch::kByte);
+	auto* colours = palette.data_ptr<uint8_t>();
+	for (size_t i = 0; i < count; ++i)
+	{
+		if (!palette_known_[indices[i]])
+		{
+			std::memcpy(colours + 3 * indices[i], rgb_buffer_.data() + 3 * i, 3);
+			palette_known_[indices[i]] = true;
+		}
+	}
+	palette_ = palette;
 }
 
 drla::EnvironmentConfiguration Atari::get_configuration() const
 {
 	drla::EnvironmentConfiguration config;
 	config.name = config_.rom_file;
-	const auto& screen = ale_.getScreen();
-	int width = config_.output_resolution[0] > 0 ? config_.output_resolution[0] : screen.width();
-	int height = config_.output_resolution[1] > 0 ? config_.output_resolution[1] : screen.height();
-	int channels = config_.frame_stack * (config_.grayscale ? 1 : 3);
-	config.observation_shapes.push_back({{channels, height, width}});
-	config.observation_dtypes.push_back(config_.use_float ? torch::kFloat : torch::kByte);
+	for (const auto* stack : {game_.frame_stack.get(), game_.ram_stack.get()})
+	{
+		if (stack != nullptr)
+		{
+			config.observation_shapes.push_back(stack->stacked_shape());
+			config.observation_dtypes.push_back(config_.use_float ? torch::kFloat : torch::kByte);
+		}
+	}
 	config.action_space = {drla::ActionSpaceType::kDiscrete, {static_cast<int>(action_set_.size())}};
-	config.action_set = get_legal_actions();
+	config.action_set = legal_actions_;
 	config.reward_types = {"score"};
 	config.num_actors = 1;
 	return config;
 }
 
-torch::Tensor Atari::get_observation()
+void Atari::capture_screen(ale::ALEInterface& emulator, std::vector<unsigned char>& buffer) const
 {
-	std::vector<unsigned char> output_buffer;
-	const auto& screen = ale_.getScreen();
-	torch::Tensor raw_frame;
-	int channels;
 	if (config_.grayscale)
 	{
-		channels = 1;
-		ale_.getScreenGrayscale(output_buffer);
+		emulator.getScreenGrayscale(buffer);
+	}
+	else
+	{
+		emulator.getScreenRGB(buffer);
+	}
+}
+
+void Atari::capture_ram(ale::ALEInterface& emulator, FrameStack& ram_stack) const
+{
+	const auto& ram = emulator.getRAM();
+	auto slot = ram_stack.next_slot();
+	if (config_.use_float)
+	{
+		float* dst = slot.data_ptr<float>();
+		for (size_t i = 0; i < ram.size(); ++i) { dst[i] = static_cast<float>(ram.get(i)) / 255.0F; }
 	}
 	else
 	{
-		channels = 3;
-		ale_.getScreenRGB(output_buffer);
+		std::memcpy(slot.data_ptr<uint8_t>(), ram.array(), ram.size());
 	}
-	raw_frame =
-		torch::from_blob(output_buffer.data(), {int(screen.height()), int(screen.width()), channels}, torch::kByte);
+	ram_stack.push();
+}
 
-	torch::Tensor obs = raw_frame.permute({2, 0, 1});
-	if (config_.output_resolution[0] > 0 || config_.output_resolution[1] > 0)
+void Atari::write_observations()
+{
+	ATARI_PERF_SCOPE(PerfStage::kObservation);
+	size_t index = 0;
+	for (const auto* stack : {game_.frame_stack.get(), game_.ram_stack.get()})
 	{
-		int width = config_.output_resolution[0] > 0 ? config_.output_resolution[0] : screen.width();
-		int height = config_.output_resolution[1] > 0 ? config_.output_resolution[1] : screen.height();
-		obs = torch::nn::functional::interpolate(
-						obs.to(torch::kFloat).div(255.0F).view({1, channels, int(screen.height()), int(screen.width())}),
-						torch::nn::functional::InterpolateFuncOptions()
-							.size(torch::make_optional<std::vector<int64_t>>({height, width}))
-							.mode(torch::kArea))
-						.view({channels, height, width});
-		if (!config_.use_float)
+		if (stack == nullptr)
 		{
-			// convert back to Byte
-			obs = (obs * 255.0F).to(torch::kByte);
+			continue;
 		}
+		stack->write(reusable_tensor(
+			observations_[index], spare_observations_[index], stack->stacked_shape(), stack->options()));
+		++index;
+	}
+}
+
+// The agent is assumed to step each environment on a thread of its own, which is pinned when it first steps the
+// environment. If a different thread steps the environment, such as when the agent restarts its env threads, that
+// thread is pinned instead. A thread stepping several environments stays pinned to the set of the last one it
+// switched to. Vector environments pin their own workers instead, so the pool based interface doesn't pin threads.
+void Atari::pin_stepping_thread()
+{
+	if (cpu_set_.empty())
+	{
+		return;
+	}
+	const auto thread = std::this_thread::get_id();
+	if (thread != pinned_thread_)
+	{
+		pinned_thread_ = thread;
+		pin_thread(cpu_set_);
+	}
+}
+
+void Atari::begin_recording()
+{
+	if (!config_.record_episodes)
+	{
+		return;
 	}
-	else if (config_.use_float)
+	recording_ = std::make_shared<EpisodeRecording>();
+	recording_->rom_md5 = rom_.md5;
+	recording_->env = config_;
+	recording_->game_seed = game_.seed;
+	recording_->repeat_action_probability = game_.emulator->getFloat("repeat_action_probability");
+	recording_->start_state = game_.start_state;
+	recording_->noop_frames = game_.noop_frames;
+}
+
+void Atari::start_replay(const EpisodeRecording& recording, torch::Tensor observation)
+{
+	if (recording.rom_md5 != rom_.md5)
 	{
-		obs = obs.to(torch::kFloat).div(255.0F);
+		spdlog::error(
+			"The recording is of the ROM with MD5 {}, but '{}' has MD5 {}",
+			recording.rom_md5,
+			rom_.path.string(),
+			rom_.md5);
+		throw std::invalid_argument("The recording is of a different ROM");
 	}
-	return obs;
+	if (game_.emulator->getFloat("repeat_action_probability") != recording.repeat_action_probability)
+	{
+		spdlog::error("The recording was made with different emulator settings");
+		throw std::invalid_argument("The recording's emulator settings differ");
+	}
+
+	game_.emulator->restoreState(ale::ALEState(recording.start_state));
+	start_game(game_, recording.noop_frames);
+	state_ = {};
+	state_.lives = game_.lives;
+	step_ = 0;
+	episode_end_ = false;
+	max_episode_steps_ = 0;
+	observation_stack().write(observation);
+}
+
+FrameStack& Atari::observation_stack() const
+{
+	return game_.frame_stack ? *game_.frame_stack : *game_.ram_stack;
 }
 
 torch::Tensor Atari::expert_agent()
@@ -201,23 +654,53 @@ torch::Tensor Atari::expert_agent()
 	return {};
 }
 
-std::vector<int> Atari::get_legal_actions() const
+SnapshotHandle Atari::snapshot(bool include_rng) const
 {
-	std::vector<int> legal_action_set;
-	auto action_set = ale_.getMinimalActionSet();
-	for (auto& action : action_set)
+	auto snapshot = snapshot_pool_->acquire(game_.frame_stack.get(), game_.ram_stack.get());
+	snapshot->ale_state = game_.emulator->cloneState(include_rng);
+	snapshot->state = state_;
+	snapshot->step = step_;
+	snapshot->episode_end = episode_end_;
+	snapshot->max_episode_steps = max_episode_steps_;
+	return snapshot;
+}
+
+void Atari::restore(const AtariSnapshot& snapshot)
+{
+	game_.emulator->restoreState(snapshot.ale_state);
+	if (game_.frame_stack)
 	{
-		auto index = action_index_.find(action);
-		if (index != action_index_.end())
-		{
-			legal_action_set.push_back(index->second);
-		}
+		game_.frame_stack->copy_from(*snapshot.frame_stack);
 	}
-	return legal_action_set;
+	if (game_.ram_stack)
+	{
+		game_.ram_stack->copy_from(*snapshot.ram_stack);
+	}
+	state_ = snapshot.state;
+	step_ = snapshot.step;
+	episode_end_ = snapshot.episode_end;
+	max_episode_steps_ = snapshot.max_episode_steps;
 }
 
 std::unique_ptr<drla::Environment> Atari::clone() const
 {
-	spdlog::error("Clonging is not supported with the atari environment");
-	return nullptr;
+	auto env = std::make_unique<Atari>(config_, env_index_);
+	// The clone continues with the same random number generators, so it starts the same games as this environment
+	env->seed_ = seed_;
+	env->seed_rng_ = seed_rng_;
+	env->reset_rng_ = reset_rng_;
+	env->restore(*snapshot());
+	env->game_.seed = game_.seed;
+	env->game_.start_state = game_.start_state;
+	env->game_.noop_frames = game_.noop_frames;
+	if (recording_)
+	{
+		env->recording_ = std::make_shared<EpisodeRecording>(*recording_);
+	}
+	// The clone's spare game was created from its own seed
+	if (env->spare_game_)
+	{
+		env->recreate_spare_game();
+	}
+	return env;
 }
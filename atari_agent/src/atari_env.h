@@ -1,19 +1,36 @@
 #pragma once
 
 #include "configuration.h"
+#include "frame_stack.h"
+#include "preprocessing.h"
+#include "rom.h"
+#include "snapshot.h"
 
 #include <ale_interface.hpp>
 #include <drla/environment.h>
 
+#include <array>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
 #include <vector>
 
 namespace atari
 {
 
+class ThreadPool;
+
 class Atari final : public drla::Environment
 {
 public:
-	Atari(const Config::AtariEnv& config);
+	/// @brief Creates the environment, validating the ROM if it is the first use of it
+	/// @param config The environment configuration, which must outlive the environment
+	/// @param env_index The index of the environment, which is added to the configured seed
+	Atari(const Config::AtariEnv& config, int env_index = 0);
+	~Atari() override;
 
 	drla::EnvironmentConfiguration get_configuration() const override;
 
@@ -25,26 +42,127 @@ public:
 
 	std::unique_ptr<drla::Environment> clone() const override;
 
+	/// @brief Steps the environment, writing the stacked observation into the supplied tensor instead of allocating one
+	/// @param action The index of the action in the minimal action set
+	/// @param observation The destination for the stacked observation
+	/// @return The reward for the step
+	float step(int action, torch::Tensor observation);
+
+	/// @brief Resets the environment, writing the stacked observation into the supplied tensor instead of allocating one
+	/// @param max_episode_steps The maximum number of steps for the episode. 0 implies no limit.
+	/// @param observation The destination for the stacked observation
+	void reset(int max_episode_steps, torch::Tensor observation);
+
+	/// @brief Indicates if the current episode has ended
+	bool is_episode_end() const;
+
+	/// @brief The shape of the stacked observation. When observing both pixels and RAM this is the pixel observation.
+	const std::vector<int64_t>& observation_shape() const;
+
+	/// @brief The data type of the observation
+	torch::ScalarType observation_dtype() const;
+
+	/// @brief Takes a snapshot of the environment state, including the emulator, frame stack and episode progress. The
+	/// snapshot storage is reused from previously released snapshots.
+	/// @param include_rng Includes the emulator's random number generator, which determines sticky actions, so that
+	/// stepping a restored snapshot with the same actions always produces the same results. Otherwise a restored
+	/// snapshot continues with the restoring emulator's random number generator.
+	/// @return The snapshot, which is returned to the pool when destroyed
+	SnapshotHandle snapshot(bool include_rng = true) const;
+
+	/// @brief Restores the environment to the state of a snapshot. The snapshot can be from any environment with the same
+	/// configuration.
+	/// @param snapshot The snapshot to restore
+	void restore(const AtariSnapshot& snapshot);
+
+	/// @brief Starts the game of a recording from the state it was recorded from. Stepping with the recorded actions then
+	/// re-emulates the game exactly.
+	/// @param recording The recording to replay, which must be of the environment's ROM
+	/// @param observation The destination for the stacked observation
+	void start_replay(const EpisodeRecording& recording, torch::Tensor observation);
+
 private:
+	// The emulator and the observations built from its frames. When resetting ahead, the environment swaps its game with
+	// a spare game started on the background thread.
+	struct Game
+	{
+		std::unique_ptr<ale::ALEInterface> emulator;
+		std::unique_ptr<FramePreprocessor> preprocessor;
+		// The stacked pixel frames, null when pixels are not observed
+		std::unique_ptr<FrameStack> frame_stack;
+		// The stacked RAM, null when the RAM is not observed
+		std::unique_ptr<FrameStack> ram_stack;
+		std::vector<unsigned char> screen_buffer;
+		int lives = 0;
+		// The emulator seed, and when recording the emulator state before the game was started and the noops performed
+		int seed = 0;
+		std::string start_state;
+		int noop_frames = 0;
+	};
+
+	void create_game(Game& game, int seed) const;
+	int next_game_seed();
+	void reseed(int seed);
+	void recreate_spare_game();
+	float advance(int action);
+	bool restart(int max_episode_steps);
+	void start_game(Game& game, int noop_frames) const;
+	void push_frame(Game& game) const;
+	void swap_spare_game();
+	void prepare_spare_game();
 	int single_step(ale::Action action);
-	torch::Tensor get_observation();
-	std::vector<int> get_legal_actions() const;
+	void capture_screen(ale::ALEInterface& emulator, std::vector<unsigned char>& buffer) const;
+	void capture_ram(ale::ALEInterface& emulator, FrameStack& ram_stack) const;
+	void update_palette(const uint8_t* indices, size_t count);
+	void write_observations();
+	void pin_stepping_thread();
+	void begin_recording();
+	FrameStack& observation_stack() const;
 
 private:
 	const Config::AtariEnv& config_;
+	const int env_index_;
+	const Rom& rom_;
 
-	ale::ALEInterface ale_;
+	Game game_;
 	ale::ActionVect action_set_;
-	std::map<ale::Action, int> action_index_;
+	// The legal actions as indices into action_set_
+	std::vector<int> legal_actions_;
 
 	EnvState state_;
 	int step_ = 0;
-	bool episode_end_;
+	bool episode_end_ = false;
 	int max_episode_steps_ = 0;
 
+	// The tensors returned by the latest step, and those of the step before which are reused once the caller releases them
 	drla::Observations observations_;
-	drla::Observations raw_observations_;
-	std::vector<torch::Tensor> buffer_;
+	drla::Observations spare_observations_;
+	torch::Tensor reward_;
+	torch::Tensor spare_reward_;
+	std::vector<unsigned char> pool_buffer_;
+	std::vector<unsigned char> rgb_buffer_;
+	// The RGB colour of each palette index seen so far, [256, 3]
+	torch::Tensor palette_;
+	std::array<bool, 256> palette_known_ = {};
+	std::shared_ptr<SnapshotPool> snapshot_pool_;
+	// Cached start states, each captured after a different number of noops. Empty entries are captured on first use.
+	std::vector<SnapshotHandle> reset_state_bank_;
+	std::mt19937 reset_rng_;
+	// The seed of the environment, which determines the emulator seed of each game it creates
+	int seed_ = -1;
+	std::mt19937 seed_rng_;
+	// The CPUs the threads creating and stepping the environment are pinned to, empty when not pinned
+	const std::vector<int>& cpu_set_;
+	// The thread which was last pinned to the CPU set when stepping the environment
+	std::thread::id pinned_thread_;
+	// The recording of the current game, null when not recording
+	std::shared_ptr<EpisodeRecording> recording_;
+
+	std::unique_ptr<Game> spare_game_;
+	std::shared_ptr<ThreadPool> reset_ahead_thread_;
+	std::mutex m_spare_game_;
+	std::condition_variable cv_spare_game_;
+	bool spare_game_ready_ = false;
 };
 
 } // namespace atari
@@ -0,0 +1,104 @@
+#include "frame_stack.h"
+
+#include <algorithm>
+#include <cstring>
+
+using namespace atari;
+
+FrameStack::FrameStack(int depth, const std::vector<int64_t>& frame_shape, torch::ScalarType dtype)
+		: depth_(std::max(depth, 1)), stacked_shape_(frame_shape)
+{
+	std::vector<int64_t> shape = {depth_};
+	shape.insert(shape.end(), frame_shape.begin(), frame_shape.end());
+	frames_ = torch::zeros(shape, dtype);
+	stacked_shape_.front() *= depth_;
+	for (int i = 0; i < depth_; ++i) { slots_.push_back(frames_[i]); }
+	frame_bytes_ = slots_.front().nbytes();
+}
+
+FrameStack::FrameStack(const FrameStack& other)
+		: depth_(other.depth_)
+		, stacked_shape_(other.stacked_shape_)
+		, frames_(other.frames_.clone())
+		, frame_bytes_(other.frame_bytes_)
+		, head_(other.head_)
+		, count_(other.count_)
+{
+	for (int i = 0; i < depth_; ++i) { slots_.push_back(frames_[i]); }
+}
+
+void FrameStack::copy_from(const FrameStack& other)
+{
+	frames_.copy_(other.frames_);
+	head_ = other.head_;
+	count_ = other.count_;
+}
+
+torch::Tensor FrameStack::next_slot()
+{
+	return slots_[head_];
+}
+
+void FrameStack::push()
+{
+	head_ = (head_ + 1) % depth_;
+	count_ = std::min(count_ + 1, depth_);
+}
+
+void FrameStack::fill()
+{
+	if (count_ == 0)
+	{
+		return;
+	}
+	const auto& newest = slots_[(head_ + depth_ - 1) % depth_];
+	while (count_ < depth_)
+	{
+		slots_[head_].copy_(newest);
+		push();
+	}
+}
+
+void FrameStack::clear()
+{
+	head_ = 0;
+	count_ = 0;
+}
+
+void FrameStack::write(torch::Tensor dst) const
+{
+	// When full the oldest frame is at head_, so the stack is the frames [head_, depth_) followed by [0, head_)
+	int tail = depth_ - head_;
+	if (
+		dst.is_cpu() && dst.is_contiguous() && dst.scalar_type() == frames_.scalar_type() &&
+		dst.numel() == frames_.numel())
+	{
+		// Copy the raw bytes directly, which avoids creating any intermediate tensor views
+		auto* dst_data = static_cast<uint8_t*>(dst.data_ptr());
+		const auto* src_data = static_cast<const uint8_t*>(frames_.data_ptr());
+		std::memcpy(dst_data, src_data + head_ * frame_bytes_, tail * frame_bytes_);
+		std::memcpy(dst_data + tail * frame_bytes_, src_data, head_ * frame_bytes_);
+		return;
+	}
+	auto dst_frames = dst.view(frames_.sizes());
+	dst_frames.narrow(0, 0, tail).copy_(frames_.narrow(0, head_, tail));
+	if (head_ > 0)
+	{
+		dst_frames.narrow(0, tail, head_).copy_(frames_.narrow(0, 0, head_));
+	}
+}
+
+const std::vector<int64_t>& FrameStack::stacked_shape() const
+{
+	return stacked_shape_;
+}
+
+int FrameStack::size() const
+{
+	return count_;
+}
+
+torch::TensorOptions FrameStack::options() const
+{
+	return frames_.options();
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <torch/torch.h>
+
+#include <vector>
+
+namespace atari
+{
+
+/// @brief A preallocated circular store of the most recent frames. New frames are written once in place and the
+/// stacked observation is assembled with a single contiguous write, avoiding reallocating or shifting stored frames.
+class FrameStack
+{
+public:
+	/// @brief Creates a frame stack, preallocating the storage for all frames
+	/// @param depth The number of frames to stack
+	/// @param frame_shape The shape of a single frame, i.e. [C, H, W]
+	/// @param dtype The data type of the frames
+	FrameStack(int depth, const std::vector<int64_t>& frame_shape, torch::ScalarType dtype);
+
+	/// @brief Creates a deep copy of a frame stack, with its own storage
+	/// @param other The frame stack to copy
+	FrameStack(const FrameStack& other);
+
+	FrameStack& operator=(const FrameStack&) = delete;
+
+	/// @brief Copies the frames and position of another frame stack of the same shape into this one's storage
+	/// @param other The frame stack to copy
+	void copy_from(const FrameStack& other);
+
+	/// @brief Returns the storage slot the next frame should be written to. The frame becomes part of the stack once
+	/// push() is called.
+	/// @return A view of the slot with the shape of a single frame
+	torch::Tensor next_slot();
+
+	/// @brief Adds the frame written to next_slot() as the newest frame, discarding the oldest frame if full.
+	void push();
+
+	/// @brief Repeats the newest frame until the stack is full.
+	void fill();
+
+	/// @brief Removes all frames from the stack. The storage remains allocated.
+	void clear();
+
+	/// @brief Writes the stacked frames, oldest first, concatenated along the first dimension.
+	/// @param dst The destination tensor with the shape returned by stacked_shape()
+	void write(torch::Tensor dst) const;
+
+	/// @brief The shape of the stacked observation, which is the frame shape with the first dimension multiplied by the
+	/// stack depth.
+	const std::vector<int64_t>& stacked_shape() const;
+
+	/// @brief The number of frames currently in the stack
+	int size() const;
+
+	/// @brief The options of the frame tensors, i.e. the data type and device
+	torch::TensorOptions options() const;
+
+private:
+	const int depth_;
+	std::vector<int64_t> stacked_shape_;
+	torch::Tensor frames_;
+	// Views of each frame slot, created once so writing a frame does not allocate a new view
+	std::vector<torch::Tensor> slots_;
+	size_t frame_bytes_ = 0;
+	// The index of the slot the next frame is written to, which is also the oldest frame when the stack is full
+	int head_ = 0;
+	int count_ = 0;
+};
+
+} // namespace atari
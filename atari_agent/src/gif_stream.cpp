@@ -0,0 +1,188 @@
+#include "gif_stream.h"
+
+#include "thread_pool.h"
+#include "trace.h"
+
+#include <spdlog/spdlog.h>
+
+#include <algorithm>
+#include <cstring>
+#include <exception>
+#include <limits>
+
+using namespace atari;
+
+GifEncoder::GifEncoder() : pool_(std::make_unique<ThreadPool>(1))
+{
+}
+
+GifEncoder::~GifEncoder() = default;
+
+void GifEncoder::submit(std::function<void()> task)
+{
+	pool_->submit(0, std::move(task));
+}
+
+GifStream::GifStream(
+	GifEncoder& encoder, const std::filesystem::path& path, int delay, int frame_decimation, int buffer_count)
+		: encoder_(encoder)
+		, path_(path)
+		, delay_(delay * std::max(frame_decimation, 1))
+		, frame_decimation_(std::max(frame_decimation, 1))
+		, buffer_count_(std::max(buffer_count, 1))
+{
+}
+
+GifStream::~GifStream()
+{
+	close();
+}
+
+void GifStream::add_frame(const drla::Observations& visualisation)
+{
+	if (visualisation.empty() || (visualisation_count_++ % frame_decimation_) != 0)
+	{
+		return;
+	}
+	const bool indexed = visualisation.size() >= 2;
+	auto image = visualisation.front().cpu().contiguous();
+	if (!writer_)
+	{
+		const int width = static_cast<int>(image.size(1));
+		const int height = static_cast<int>(image.size(0));
+		writer_ = std::make_unique<GifWriter>(path_, width, height, delay_);
+	}
+
+	Frame frame;
+	{
+		std::unique_lock lock(m_frames_);
+		cv_free_.wait(lock, [this] { return !free_frames_.empty() || allocated_frames_ < buffer_count_; });
+		if (free_frames_.empty())
+		{
+			++allocated_frames_;
+		}
+		else
+		{
+			frame = std::move(free_frames_.back());
+			free_frames_.pop_back();
+		}
+	}
+
+	const auto* data = static_cast<const uint8_t*>(image.data_ptr());
+	frame.pixels.assign(data, data + image.nbytes());
+	frame.indexed = indexed;
+	if (indexed)
+	{
+		auto palette = visualisation[1].cpu().contiguous();
+		std::memcpy(frame.palette.data(), palette.data_ptr(), std::min(palette.nbytes(), frame.palette.size()));
+	}
+
+	{
+		std::lock_guard lock(m_frames_);
+		queued_frames_.push_back(std::move(frame));
+		++pending_frames_;
+	}
+	encoder_.submit([this] { encode_next(); });
+	++frame_count_;
+}
+
+void GifStream::close()
+{
+	if (!writer_)
+	{
+		return;
+	}
+	ATARI_TRACE_SCOPE("gif_close", "gif");
+	{
+		std::unique_lock lock(m_frames_);
+		cv_free_.wait(lock, [this] { return pending_frames_ == 0; });
+	}
+	writer_->close();
+	writer_.reset();
+}
+
+int GifStream::frame_count() const
+{
+	return frame_count_;
+}
+
+void GifStream::encode_next()
+{
+	// Each added frame queues one call, so there is always a frame to encode
+	Frame frame;
+	{
+		std::lock_guard lock(m_frames_);
+		frame = std::move(queued_frames_.front());
+		queued_frames_.pop_front();
+	}
+
+	try
+	{
+		ATARI_TRACE_SCOPE("gif_frame", "gif");
+		if (frame.indexed)
+		{
+			writer_->add_frame(frame.pixels.data(), frame.palette.data());
+		}
+		else
+		{
+			writer_->add_frame(quantise(frame.pixels), rgb_palette_.data());
+		}
+	}
+	catch (const std::exception& e)
+	{
+		spdlog::error("Failed to write a frame to '{}': {}", path_.string(), e.what());
+	}
+
+	// Notified under the lock, as once no frames are pending close() can return and the stream be destroyed
+	std::lock_guard lock(m_frames_);
+	free_frames_.push_back(std::move(frame));
+	--pending_frames_;
+	cv_free_.notify_one();
+}
+
+const uint8_t* GifStream::quantise(const std::vector<uint8_t>& rgb)
+{
+	indices_.resize(rgb.size() / 3);
+	// Neighbouring pixels are usually the same colour, so the last lookup is cached
+	uint32_t last_colour = std::numeric_limits<uint32_t>::max();
+	uint8_t last_index = 0;
+	for (size_t i = 0; i < indices_.size(); ++i)
+	{
+		const uint8_t* pixel = &rgb[i * 3];
+		const uint32_t colour = (pixel[0] << 16) | (pixel[1] << 8) | pixel[2];
+		if (colour != last_colour)
+		{
+			last_colour = colour;
+			auto [iter, inserted] = colour_indices_.try_emplace(colour, 0);
+			if (inserted)
+			{
+				const int count = static_cast<int>(colour_indices_.size()) - 1;
+				if (count < GifWriter::kPaletteSize)
+				{
+					iter->second = static_cast<uint8_t>(count);
+					std::memcpy(&rgb_palette_[count * 3], pixel, 3);
+				}
+				else
+				{
+					// The palette is full, so use the closest colour already in it
+					int best_distance = std::numeric_limits<int>::max();
+					for (int p = 0; p < GifWriter::kPaletteSize; ++p)
+					{
+						const int dr = pixel[0] - rgb_palette_[p * 3];
+						const int dg = pixel[1] - rgb_palette_[p * 3 + 1];
+						const int db = pixel[2] - rgb_palette_[p * 3 + 2];
+						const int distance = dr * dr + dg * dg + db * db;
+						if (distance < best_distance)
+						{
+							best_distance = distance;
+							iter->second = static_cast<uint8_t>(p);
+						}
+					}
+				}
+			}
+			last_index = iter->second;
+		}
+		indices_[i] = last_index;
+	}
+	return indices_.data();
+}
@@ -0,0 +1,208 @@
+#include "gif_writer.h"
+
+#include <spdlog/spdlog.h>
+
+#include <cstring>
+#include <stdexcept>
+
+using namespace atari;
+
+namespace
+{
+
+// 8 bit palette indices use 9 bit codes initially, growing to at most 12 bits
+constexpr int kMinCodeSize = 8;
+constexpr int kClearCode = 1 << kMinCodeSize;
+constexpr int kEndCode = kClearCode + 1;
+constexpr int kMaxCode = 4095;
+// A prime larger than the maximum number of codes, giving a low load factor for the LZW string table
+constexpr int kHashSize = 5003;
+
+class BitWriter
+{
+public:
+	explicit BitWriter(std::vector<uint8_t>& output) : output_(output) {}
+
+	void write(int code, int code_size)
+	{
+		buffer_ |= static_cast<uint32_t>(code) << bits_;
+		bits_ += code_size;
+		while (bits_ >= 8)
+		{
+			output_.push_back(static_cast<uint8_t>(buffer_ & 0xFF));
+			buffer_ >>= 8;
+			bits_ -= 8;
+		}
+	}
+
+	void flush()
+	{
+		if (bits_ > 0)
+		{
+			output_.push_back(static_cast<uint8_t>(buffer_ & 0xFF));
+		}
+		buffer_ = 0;
+		bits_ = 0;
+	}
+
+private:
+	std::vector<uint8_t>& output_;
+	uint32_t buffer_ = 0;
+	int bits_ = 0;
+};
+
+void write_u16(std::ofstream& file, int value)
+{
+	file.put(static_cast<char>(value & 0xFF));
+	file.put(static_cast<char>((value >> 8) & 0xFF));
+}
+
+} // namespace
+
+GifWriter::GifWriter(const std::filesystem::path& path, int width, int height, int delay)
+		: file_(path, std::ios::binary), width_(width), height_(height), delay_(delay)
+{
+	if (!file_.is_open())
+	{
+		spdlog::error("Unable to open '{}' to write the GIF", path.string());
+		throw std::runtime_error("Unable to open the GIF file");
+	}
+	lzw_keys_.resize(kHashSize);
+	lzw_codes_.resize(kHashSize);
+}
+
+GifWriter::~GifWriter()
+{
+	close();
+}
+
+void GifWriter::add_frame(const uint8_t* indices, const uint8_t* palette)
+{
+	if (!header_written_)
+	{
+		write_header(palette);
+	}
+
+	// Graphic control extension, setting the frame delay
+	file_.put(0x21);
+	file_.put(static_cast<char>(0xF9));
+	file_.put(4);
+	file_.put(0);
+	write_u16(file_, delay_);
+	file_.put(0);
+	file_.put(0);
+
+	// Image descriptor, with a local colour table only when the palette differs from the global colour table
+	const bool local_palette = std::memcmp(palette, global_palette_.data(), global_palette_.size()) != 0;
+	file_.put(0x2C);
+	write_u16(file_, 0);
+	write_u16(file_, 0);
+	write_u16(file_, width_);
+	write_u16(file_, height_);
+	file_.put(static_cast<char>(local_palette ? 0x87 : 0));
+	if (local_palette)
+	{
+		file_.write(reinterpret_cast<const char*>(palette), kPaletteSize * 3);
+	}
+
+	write_image_data(indices);
+}
+
+void GifWriter::close()
+{
+	if (!file_.is_open())
+	{
+		return;
+	}
+	if (!header_written_)
+	{
+		write_header(global_palette_.data());
+	}
+	file_.put(0x3B);
+	file_.close();
+}
+
+void GifWriter::write_header(const uint8_t* palette)
+{
+	file_.write("GIF89a", 6);
+	write_u16(file_, width_);
+	write_u16(file_, height_);
+	// A global colour table of 256 entries with 8 bits per primary colour
+	file_.put(static_cast<char>(0xF7));
+	file_.put(0);
+	file_.put(0);
+	std::memcpy(global_palette_.data(), palette, global_palette_.size());
+	file_.write(reinterpret_cast<const char*>(global_palette_.data()), global_palette_.size());
+
+	// Netscape application extension, looping the animation indefinitely
+	file_.put(0x21);
+	file_.put(static_cast<char>(0xFF));
+	file_.put(11);
+	file_.write("NETSCAPE2.0", 11);
+	file_.put(3);
+	file_.put(1);
+	write_u16(file_, 0);
+	file_.put(0);
+
+	header_written_ = true;
+}
+
+void GifWriter::write_image_data(const uint8_t* indices)
+{
+	image_data_.clear();
+	BitWriter writer(image_data_);
+	std::fill(lzw_keys_.begin(), lzw_keys_.end(), -1);
+
+	int code_size = kMinCodeSize + 1;
+	int max_code = kEndCode;
+	writer.write(kClearCode, code_size);
+
+	const int pixel_count = width_ * height_;
+	int prefix = indices[0];
+	for (int i = 1; i < pixel_count; ++i)
+	{
+		const int value = indices[i];
+		// The string table maps a prefix code followed by a value to its code
+		const int32_t key = (prefix << 8) | value;
+		int hash = ((value << 4) ^ prefix) % kHashSize;
+		while (lzw_keys_[hash] >= 0 && lzw_keys_[hash] != key) { hash = (hash + 1) % kHashSize; }
+		if (lzw_keys_[hash] == key)
+		{
+			prefix = lzw_codes_[hash];
+			continue;
+		}
+
+		writer.write(prefix, code_size);
+		lzw_keys_[hash] = key;
+		lzw_codes_[hash] = static_cast<uint16_t>(++max_code);
+		if (max_code >= (1 << code_size))
+		{
+			++code_size;
+		}
+		if (max_code == kMaxCode)
+		{
+			writer.write(kClearCode, code_size);
+			std::fill(lzw_keys_.begin(), lzw_keys_.end(), -1);
+			code_size = kMinCodeSize + 1;
+			max_code = kEndCode;
+		}
+		prefix = value;
+	}
+	writer.write(prefix, code_size);
+	// The decoder adds a table entry on reading the last code, which can increase its code size before the end code
+	if (max_code + 1 >= (1 << code_size) && code_size < 12)
+	{
+		++code_size;
+	}
+	writer.write(kEndCode, code_size);
+	writer.flush();
+
+	file_.put(kMinCodeSize);
+	for (size_t offset = 0; offset < image_data_.size(); offset += 255)
+	{
+		const size_t block_size = std::min<size_t>(255, image_data_.size() - offset);
+		file_.put(static_cast<char>(block_size));
+		file_.write(reinterpret_cast<const char*>(image_data_.data() + offset), static_cast<std::streamsize>(block_size));
+	}
+	file_.put(0);
+}
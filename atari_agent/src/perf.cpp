@@ -0,0 +1,109 @@
+#include "perf.h"
+
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <vector>
+
+using namespace atari;
+
+namespace
+{
+
+// The counters of a single thread. Only the owning thread writes to them, so updates are plain relaxed stores rather
+// than read-modify-write operations, while other threads can still read them safely.
+struct ThreadCounters
+{
+	std::array<std::atomic<uint64_t>, kPerfStageCount> calls{};
+	std::array<std::atomic<uint64_t>, kPerfStageCount> ns{};
+};
+
+struct Registry
+{
+	std::mutex m_threads;
+	std::vector<const ThreadCounters*> threads;
+	// The counts of threads which have exited
+	PerfCounters retired{};
+};
+
+Registry& registry()
+{
+	static Registry registry;
+	return registry;
+}
+
+void add(PerfCounters& totals, const ThreadCounters& counters)
+{
+	for (int i = 0; i < kPerfStageCount; ++i)
+	{
+		totals[i].calls += counters.calls[i].load(std::memory_order_relaxed);
+		totals[i].ns += counters.ns[i].load(std::memory_order_relaxed);
+	}
+}
+
+// Registers the thread's counters on the thread's first use, moving them into the retired counts when the thread exits
+class ThreadRegistration
+{
+public:
+	ThreadRegistration()
+	{
+		auto& reg = registry();
+		std::lock_guard lock(reg.m_threads);
+		reg.threads.push_back(&counters);
+	}
+
+	~ThreadRegistration()
+	{
+		auto& reg = registry();
+		std::lock_guard lock(reg.m_threads);
+		add(reg.retired, counters);
+		reg.threads.erase(std::find(reg.threads.begin(), reg.threads.end(), &counters));
+	}
+
+	ThreadCounters counters;
+};
+
+ThreadCounters& thread_counters()
+{
+	thread_local ThreadRegistration registration;
+	return registration.counters;
+}
+
+} // namespace
+
+const char* atari::perf_stage_name(PerfStage stage)
+{
+	switch (stage)
+	{
+		case PerfStage::kStep: return "step";
+		case PerfStage::kEmulation: return "emulation";
+		case PerfStage::kPreprocess: return "preprocess";
+		case PerfStage::kObservation: return "observation";
+		case PerfStage::kReset: return "reset";
+		case PerfStage::kVisualisation: return "visualisation";
+		case PerfStage::kEnvResetCallback: return "env_reset_callback";
+		case PerfStage::kEnvStepCallback: return "env_step_callback";
+		case PerfStage::kTrainUpdateCallback: return "train_update_callback";
+		case PerfStage::kCount: break;
+	}
+	return "unknown";
+}
+
+void atari::perf_record(PerfStage stage, uint64_t ns)
+{
+	auto& counters = thread_counters();
+	const auto index = static_cast<size_t>(stage);
+	auto& calls = counters.calls[index];
+	auto& total_ns = counters.ns[index];
+	calls.store(calls.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+	total_ns.store(total_ns.load(std::memory_order_relaxed) + ns, std::memory_order_relaxed);
+}
+
+PerfCounters atari::perf_totals()
+{
+	auto& reg = registry();
+	std::lock_guard lock(reg.m_threads);
+	PerfCounters totals = reg.retired;
+	for (const auto* counters : reg.threads) { add(totals, *counters); }
+	return totals;
+}
@@ -0,0 +1,361 @@
+#include "preprocessing.h"
+
+#include <algorithm>
+#include <cstring>
+#include <type_traits>
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#define ATARI_X86_SIMD
+#endif
+
+using namespace atari;
+
+namespace
+{
+
+AreaResizePlan make_plan(int input_size, int output_size)
+{
+	AreaResizePlan plan;
+	plan.output_size = output_size;
+	plan.start.resize(output_size);
+	plan.end.resize(output_size);
+	plan.bin_size.resize(output_size);
+	for (int o = 0; o < output_size; ++o)
+	{
+		// The same bins as torch's adaptive average pooling
+		plan.start[o] = (o * input_size) / output_size;
+		plan.end[o] = ((o + 1) * input_size + output_size - 1) / output_size;
+		plan.bin_size[o] = static_cast<float>(plan.end[o] - plan.start[o]);
+		plan.max_size = std::max(plan.max_size, plan.end[o] - plan.start[o]);
+	}
+	plan.tap_index.resize(plan.max_size * output_size);
+	plan.tap_mask.resize(plan.max_size * output_size);
+	for (int k = 0; k < plan.max_size; ++k)
+	{
+		for (int o = 0; o < output_size; ++o)
+		{
+			bool in_bin = plan.start[o] + k < plan.end[o];
+			plan.tap_index[k * output_size + o] = in_bin ? plan.start[o] + k : plan.start[o];
+			plan.tap_mask[k * output_size + o] = in_bin ? -1 : 0;
+		}
+	}
+	return plan;
+}
+
+// torch's area interpolation accumulates the scaled inputs of a bin row by row in float, then divides by the bin
+// height and width in turn. Byte observations are then scaled back by 255 and truncated. The kernels below perform
+// exactly the same operations per output element, adding zero for taps outside narrower bins, which leaves the sum
+// unchanged.
+
+template <typename T>
+inline T to_output(float average)
+{
+	if constexpr (std::is_same_v<T, float>)
+	{
+		return average;
+	}
+	else
+	{
+		return static_cast<uint8_t>(average * 255.0F);
+	}
+}
+
+template <typename T>
+void resize_columns_scalar(const float* rows, int row_stride, int kh, const AreaResizePlan& plan, int begin, T* dst)
+{
+	for (int ow = begin; ow < plan.output_size; ++ow)
+	{
+		float sum = 0.0F;
+		for (int r = 0; r < kh; ++r)
+		{
+			const float* row = rows + r * row_stride;
+			for (int iw = plan.start[ow]; iw < plan.end[ow]; ++iw) { sum += row[iw]; }
+		}
+		dst[ow] = to_output<T>(sum / static_cast<float>(kh) / plan.bin_size[ow]);
+	}
+}
+
+template <typename T>
+void resize_columns_generic(const float* rows, int row_stride, int kh, const AreaResizePlan& plan, T* dst)
+{
+	resize_columns_scalar(rows, row_stride, kh, plan, 0, dst);
+}
+
+#ifdef ATARI_X86_SIMD
+
+template <typename T>
+__attribute__((target("avx2"))) void
+resize_columns_avx2(const float* rows, int row_stride, int kh, const AreaResizePlan& plan, T* dst)
+{
+	const __m256 kh_v = _mm256_set1_ps(static_cast<float>(kh));
+	int ow = 0;
+	for (; ow + 8 <= plan.output_size; ow += 8)
+	{
+		__m256 sum = _mm256_setzero_ps();
+		for (int r = 0; r < kh; ++r)
+		{
+			const float* row = rows + r * row_stride;
+			for (int k = 0; k < plan.max_size; ++k)
+			{
+				const int offset = k * plan.output_size + ow;
+				__m256i index = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(plan.tap_index.data() + offset));
+				__m256i mask = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(plan.tap_mask.data() + offset));
+				sum = _mm256_add_ps(sum, _mm256_and_ps(_mm256_i32gather_ps(row, index, 4), _mm256_castsi256_ps(mask)));
+			}
+		}
+		__m256 average = _mm256_div_ps(_mm256_div_ps(sum, kh_v), _mm256_loadu_ps(plan.bin_size.data() + ow));
+		if constexpr (std::is_same_v<T, float>)
+		{
+			_mm256_storeu_ps(dst + ow, average);
+		}
+		else
+		{
+			__m256i values = _mm256_cvttps_epi32(_mm256_mul_ps(average, _mm256_set1_ps(255.0F)));
+			__m128i words = _mm_packs_epi32(_mm256_castsi256_si128(values), _mm256_extracti128_si256(values, 1));
+			_mm_storel_epi64(reinterpret_cast<__m128i*>(dst + ow), _mm_packus_epi16(words, words));
+		}
+	}
+	resize_columns_scalar(rows, row_stride, kh, plan, ow, dst);
+}
+
+template <typename T>
+void resize_columns_sse2(const float* rows, int row_stride, int kh, const AreaResizePlan& plan, T* dst)
+{
+	const __m128 kh_v = _mm_set1_ps(static_cast<float>(kh));
+	int ow = 0;
+	for (; ow + 4 <= plan.output_size; ow += 4)
+	{
+		__m128 sum = _mm_setzero_ps();
+		for (int r = 0; r < kh; ++r)
+		{
+			const float* row = rows + r * row_stride;
+			for (int k = 0; k < plan.max_size; ++k)
+			{
+				const int offset = k * plan.output_size + ow;
+				const int32_t* index = plan.tap_index.data() + offset;
+				__m128i mask = _mm_loadu_si128(reinterpret_cast<const __m128i*>(plan.tap_mask.data() + offset));
+				__m128 value = _mm_setr_ps(row[index[0]], row[index[1]], row[index[2]], row[index[3]]);
+				sum = _mm_add_ps(sum, _mm_and_ps(value, _mm_castsi128_ps(mask)));
+			}
+		}
+		__m128 average = _mm_div_ps(_mm_div_ps(sum, kh_v), _mm_loadu_ps(plan.bin_size.data() + ow));
+		if constexpr (std::is_same_v<T, float>)
+		{
+			_mm_storeu_ps(dst + ow, average);
+		}
+		else
+		{
+			__m128i values = _mm_cvttps_epi32(_mm_mul_ps(average, _mm_set1_ps(255.0F)));
+			__m128i words = _mm_packs_epi32(values, values);
+			int32_t bytes = _mm_cvtsi128_si32(_mm_packus_epi16(words, words));
+			std::memcpy(dst + ow, &bytes, sizeof(bytes));
+		}
+	}
+	resize_columns_scalar(rows, row_stride, kh, plan, ow, dst);
+}
+
+#endif
+
+void max_pool_scalar(const uint8_t* src, uint8_t* dst, int begin, int size)
+{
+	for (int i = begin; i < size; ++i) { dst[i] = std::max(dst[i], src[i]); }
+}
+
+void max_pool_generic(const uint8_t* src, uint8_t* dst, int size)
+{
+	max_pool_scalar(src, dst, 0, size);
+}
+
+#ifdef ATARI_X86_SIMD
+
+__attribute__((target("avx2"))) void max_pool_avx2(const uint8_t* src, uint8_t* dst, int size)
+{
+	int i = 0;
+	for (; i + 32 <= size; i += 32)
+	{
+		__m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i));
+		__m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(dst + i));
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), _mm256_max_epu8(a, b));
+	}
+	max_pool_scalar(src, dst, i, size);
+}
+
+void max_pool_sse2(const uint8_t* src, uint8_t* dst, int size)
+{
+	int i = 0;
+	for (; i + 16 <= size; i += 16)
+	{
+		__m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+		__m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(dst + i));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_max_epu8(a, b));
+	}
+	max_pool_scalar(src, dst, i, size);
+}
+
+#endif
+
+FramePreprocessor::MaxPoolFn select_max_pool(SimdLevel simd_level)
+{
+#ifdef ATARI_X86_SIMD
+	switch (simd_level)
+	{
+		case SimdLevel::kAVX2: return max_pool_avx2;
+		case SimdLevel::kSSE2: return max_pool_sse2;
+		case SimdLevel::kScalar: break;
+	}
+#endif
+	return max_pool_generic;
+}
+
+template <typename T>
+FramePreprocessor::ResizeColumnsFn<T> select_resize_columns(SimdLevel simd_level)
+{
+#ifdef ATARI_X86_SIMD
+	switch (simd_level)
+	{
+		case SimdLevel::kAVX2: return resize_columns_avx2<T>;
+		case SimdLevel::kSSE2: return resize_columns_sse2<T>;
+		case SimdLevel::kScalar: break;
+	}
+#endif
+	return resize_columns_generic<T>;
+}
+
+} // namespace
+
+SimdLevel atari::detect_simd_level()
+{
+#ifdef ATARI_X86_SIMD
+	static const bool has_avx2 = __builtin_cpu_supports("avx2");
+	// SSE2 is part of the x86-64 baseline
+	return has_avx2 ? SimdLevel::kAVX2 : SimdLevel::kSSE2;
+#else
+	return SimdLevel::kScalar;
+#endif
+}
+
+FramePreprocessor::FramePreprocessor(
+	const Config::AtariEnv& config, int screen_height, int screen_width, SimdLevel simd_level)
+		: channels_(config.grayscale ? 1 : 3)
+		, screen_height_(screen_height)
+		, screen_width_(screen_width)
+		, resize_(config.output_resolution[0] > 0 || config.output_resolution[1] > 0)
+		, use_float_(config.use_float)
+{
+	int width = config.output_resolution[0] > 0 ? config.output_resolution[0] : screen_width;
+	int height = config.output_resolution[1] > 0 ? config.output_resolution[1] : screen_height;
+	rows_ = make_plan(screen_height, height);
+	cols_ = make_plan(screen_width, width);
+	row_buffer_.resize(rows_.max_size * screen_width);
+	// Kernels the CPU doesn't support fall back to the widest supported instruction set
+	simd_level = std::min(simd_level, detect_simd_level());
+	max_pool_fn_ = select_max_pool(simd_level);
+	resize_bytes_fn_ = select_resize_columns<uint8_t>(simd_level);
+	resize_floats_fn_ = select_resize_columns<float>(simd_level);
+	pipeline_ = channels_ == 1 ? select_pipeline<1>() : select_pipeline<3>();
+}
+
+void FramePreprocessor::process(const uint8_t* screen, torch::Tensor dst)
+{
+	(this->*pipeline_)(screen, dst.data_ptr());
+}
+
+void FramePreprocessor::process(const uint8_t* screen, void* dst)
+{
+	(this->*pipeline_)(screen, dst);
+}
+
+void FramePreprocessor::max_pool(const uint8_t* screen, uint8_t* dst) const
+{
+	max_pool_fn_(screen, dst, screen_size());
+}
+
+int FramePreprocessor::screen_size() const
+{
+	return screen_height_ * screen_width_ * channels_;
+}
+
+std::vector<int64_t> FramePreprocessor::frame_shape() const
+{
+	return {channels_, rows_.output_size, cols_.output_size};
+}
+
+template <int Channels, bool Resize, typename T>
+void FramePreprocessor::run(const uint8_t* screen, void* dst)
+{
+	if constexpr (Resize)
+	{
+		resize<Channels>(screen, static_cast<T*>(dst));
+	}
+	else
+	{
+		convert<Channels>(screen, static_cast<T*>(dst));
+	}
+}
+
+template <int Channels>
+FramePreprocessor::PipelineFn FramePreprocessor::select_pipeline() const
+{
+	if (use_float_)
+	{
+		return resize_ ? &FramePreprocessor::run<Channels, true, float> : &FramePreprocessor::run<Channels, false, float>;
+	}
+	return resize_ ? &FramePreprocessor::run<Channels, true, uint8_t> : &FramePreprocessor::run<Channels, false, uint8_t>;
+}
+
+template <int Channels, typename T>
+void FramePreprocessor::resize(const uint8_t* screen, T* dst)
+{
+	ResizeColumnsFn<T> resize_columns = nullptr;
+	if constexpr (std::is_same_v<T, float>)
+	{
+		resize_columns = resize_floats_fn_;
+	}
+	else
+	{
+		resize_columns = resize_bytes_fn_;
+	}
+	for (int c = 0; c < Channels; ++c)
+	{
+		for (int oh = 0; oh < rows_.output_size; ++oh)
+		{
+			const int kh = rows_.end[oh] - rows_.start[oh];
+			for (int r = 0; r < kh; ++r)
+			{
+				const uint8_t* src = screen + ((rows_.start[oh] + r) * screen_width_) * Channels + c;
+				float* row = row_buffer_.data() + r * screen_width_;
+				// Dividing rather than multiplying by the reciprocal matches the scaling performed by torch
+				for (int iw = 0; iw < screen_width_; ++iw) { row[iw] = static_cast<float>(src[iw * Channels]) / 255.0F; }
+			}
+			resize_columns(row_buffer_.data(), screen_width_, kh, cols_, dst);
+			dst += cols_.output_size;
+		}
+	}
+}
+
+template <int Channels, typename T>
+void FramePreprocessor::convert(const uint8_t* screen, T* dst)
+{
+	const int plane = screen_height_ * screen_width_;
+	if constexpr (Channels == 1 && std::is_same_v<T, uint8_t>)
+	{
+		std::memcpy(dst, screen, plane);
+		return;
+	}
+	for (int c = 0; c < Channels; ++c)
+	{
+		for (int i = 0; i < plane; ++i)
+		{
+			if constexpr (std::is_same_v<T, float>)
+			{
+				dst[i] = static_cast<float>(screen[i * Channels + c]) / 255.0F;
+			}
+			else
+			{
+				dst[i] = screen[i * Channels + c];
+			}
+		}
+		dst += plane;
+	}
+}
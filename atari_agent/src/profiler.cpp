@@ -0,0 +1,330 @@
+#include "profiler.h"
+
+#include "affinity.h"
+#include "atari_env.h"
+#include "perf.h"
+
+#include <spdlog/spdlog.h>
+
+#include <algorithm>
+#include <chrono>
+#include <limits>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+
+using namespace atari;
+
+namespace
+{
+
+using Clock = std::chrono::steady_clock;
+
+double seconds(uint64_t ns)
+{
+	return static_cast<double>(ns) / 1e9;
+}
+
+uint64_t elapsed_ns(Clock::time_point start)
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count();
+}
+
+PerfCounters start_profiling()
+{
+	if constexpr (!kPerfEnabled)
+	{
+		spdlog::warn("Built without ATARI_ENABLE_PERF, so the time spent in the environments can't be measured");
+	}
+	return perf_totals();
+}
+
+ProfileResult stop_profiling(const PerfCounters& start, int env_count, double duration)
+{
+	const auto end = perf_totals();
+	auto counter = [&](PerfStage stage) {
+		const auto index = static_cast<size_t>(stage);
+		return PerfCounter{end[index].calls - start[index].calls, end[index].ns - start[index].ns};
+	};
+
+	ProfileResult result;
+	result.env_count = env_count;
+	result.duration = duration;
+	result.steps = counter(PerfStage::kStep).calls;
+	result.frames = counter(PerfStage::kEmulation).calls;
+	const uint64_t preprocess_ns = counter(PerfStage::kPreprocess).ns;
+	result.preprocessing = seconds(preprocess_ns + counter(PerfStage::kObservation).ns);
+	result.emulation = seconds(counter(PerfStage::kStep).ns - preprocess_ns);
+	result.reset = seconds(counter(PerfStage::kReset).ns);
+	return result;
+}
+
+// The time of all environment threads not accounted for by the environments and callbacks
+double unaccounted_time(const ProfileResult& result)
+{
+	const double thread_time = result.env_count * result.duration;
+	return std::max(
+		thread_time - result.emulation - result.preprocessing - result.reset - result.callbacks - result.policy, 0.0);
+}
+
+} // namespace
+
+ProfileCallback::ProfileCallback(drla::AgentCallbackInterface* callback) : callback_(callback)
+{
+}
+
+void ProfileCallback::set_callback(drla::AgentCallbackInterface* callback)
+{
+	callback_ = callback;
+}
+
+void ProfileCallback::start(int env_count, int step_limit)
+{
+	callback_ns_ = 0;
+	step_limit_ = step_limit;
+	start_ = Clock::now();
+	envs_.assign(env_count, {0, start_});
+}
+
+double ProfileCallback::callback_time() const
+{
+	return seconds(callback_ns_.load());
+}
+
+double ProfileCallback::env_time() const
+{
+	uint64_t ns = 0;
+	for (const auto& env : envs_)
+	{
+		ns += std::chrono::duration_cast<std::chrono::nanoseconds>(env.last_step - start_).count();
+	}
+	return seconds(ns);
+}
+
+void ProfileCallback::train_init(const drla::InitData& data)
+{
+	if (callback_ != nullptr)
+	{
+		const auto start = Clock::now();
+		callback_->train_init(data);
+		callback_ns_ += elapsed_ns(start);
+	}
+}
+
+drla::AgentResetConfig ProfileCallback::env_reset(const drla::StepData& data)
+{
+	if (callback_ == nullptr)
+	{
+		return {};
+	}
+	const auto start = Clock::now();
+	auto reset_config = callback_->env_reset(data);
+	callback_ns_ += elapsed_ns(start);
+	return reset_config;
+}
+
+bool ProfileCallback::env_step(const drla::StepData& data)
+{
+	bool stop = false;
+	if (callback_ != nullptr)
+	{
+		const auto start = Clock::now();
+		stop = callback_->env_step(data);
+		callback_ns_ += elapsed_ns(start);
+	}
+	auto& env = envs_.at(data.env);
+	env.last_step = Clock::now();
+	if (step_limit_ > 0)
+	{
+		// Episodes which end early are continued, so every environment runs the same number of steps
+		stop = ++env.steps >= step_limit_;
+	}
+	return stop;
+}
+
+void ProfileCallback::train_update(const drla::TrainUpdateData& data)
+{
+	if (callback_ != nullptr)
+	{
+		const auto start = Clock::now();
+		callback_->train_update(data);
+		callback_ns_ += elapsed_ns(start);
+	}
+}
+
+torch::Tensor ProfileCallback::interactive_step()
+{
+	return callback_ != nullptr ? callback_->interactive_step() : torch::Tensor{};
+}
+
+void ProfileCallback::save(int steps, const std::filesystem::path& path)
+{
+	if (callback_ != nullptr)
+	{
+		callback_->save(steps, path);
+	}
+}
+
+ProfileResult atari::profile_agent(
+	ProfileCallback& callback, int env_count, int step_limit, const std::function<void()>& run)
+{
+	const auto counters = start_profiling();
+	const auto start = Clock::now();
+	callback.start(env_count, step_limit);
+	run();
+	auto result = stop_profiling(counters, env_count, seconds(elapsed_ns(start)));
+	result.callbacks = callback.callback_time();
+	// Environments which finished their steps early idle until the run ends, which isn't time spent on the policy
+	result.policy = std::max(
+		callback.env_time() - result.emulation - result.preprocessing - result.reset - result.callbacks, 0.0);
+	result.other = unaccounted_time(result);
+	return result;
+}
+
+ProfileResult atari::profile_policy(const Config::AtariEnv& config, int env_count, int steps, ProfilePolicy policy)
+{
+	if (policy == ProfilePolicy::kModel)
+	{
+		spdlog::error("The model policy must be profiled by running the agent");
+		throw std::invalid_argument("Unsupported profile policy");
+	}
+
+	// The environments are created up front so loading the ROMs isn't profiled
+	std::vector<std::unique_ptr<Atari>> envs;
+	for (int i = 0; i < env_count; ++i) { envs.push_back(std::make_unique<Atari>(config, i)); }
+
+	std::atomic<uint64_t> policy_ns = 0;
+	const auto counters = start_profiling();
+	const auto start = Clock::now();
+	std::vector<std::thread> threads;
+	for (int i = 0; i < env_count; ++i)
+	{
+		threads.emplace_back([&, i]() {
+			pin_thread(env_cpu_set(config, i));
+			auto& env = *envs[i];
+			auto observation = torch::empty(env.observation_shape(), env.observation_dtype());
+			env.reset(0, observation);
+			const int action_count = static_cast<int>(env.get_configuration().action_set.size());
+			std::mt19937 rng(i);
+			std::uniform_int_distribution<int> dist(0, action_count - 1);
+			uint64_t thread_policy_ns = 0;
+			for (int step = 0; step < steps; ++step)
+			{
+				const auto policy_start = Clock::now();
+				const int action = policy == ProfilePolicy::kRandom ? dist(rng) : 0;
+				thread_policy_ns += elapsed_ns(policy_start);
+				env.step(action, observation);
+				if (env.is_episode_end())
+				{
+					env.reset(0, observation);
+				}
+			}
+			policy_ns += thread_policy_ns;
+		});
+	}
+	for (auto& thread : threads) { thread.join(); }
+
+	auto result = stop_profiling(counters, env_count, seconds(elapsed_ns(start)));
+	result.policy = seconds(policy_ns);
+	result.policy_measured = true;
+	result.other = unaccounted_time(result);
+	return result;
+}
+
+std::vector<int> atari::default_profile_env_counts()
+{
+	const int max_env_count = std::max(static_cast<int>(std::thread::hardware_concurrency()), 1);
+	std::vector<int> env_counts;
+	for (int env_count = 1; env_count < max_env_count; env_count *= 2) { env_counts.push_back(env_count); }
+	env_counts.push_back(max_env_count);
+	return env_counts;
+}
+
+std::vector<int> atari::parse_profile_env_counts(const std::string& env_counts)
+{
+	if (env_counts.empty())
+	{
+		return default_profile_env_counts();
+	}
+	std::vector<int> result;
+	std::stringstream stream(env_counts);
+	std::string item;
+	while (std::getline(stream, item, ','))
+	{
+		result.push_back(std::max(std::stoi(item), 1));
+	}
+	return result;
+}
+
+ProfilePolicy atari::parse_profile_policy(const std::string& policy)
+{
+	if (policy == "model")
+	{
+		return ProfilePolicy::kModel;
+	}
+	if (policy == "random")
+	{
+		return ProfilePolicy::kRandom;
+	}
+	if (policy == "fixed")
+	{
+		return ProfilePolicy::kFixed;
+	}
+	spdlog::error("Unknown profile policy '{}', expected 'model', 'random' or 'fixed'", policy);
+	throw std::invalid_argument("Unknown profile policy");
+}
+
+void atari::print_profile(const std::vector<ProfileResult>& results)
+{
+	if (results.empty())
+	{
+		return;
+	}
+	spdlog::fmt_lib::print(
+		"{:>5} {:>12} {:>12} {:>10} {:>10} {:>8} {:>8} {:>10} {:>8}\n",
+		"envs",
+		"steps/s",
+		"frames/s",
+		"emulation",
+		"preprocess",
+		"reset",
+		"policy",
+		"callbacks",
+		"other");
+	double peak = 0;
+	for (const auto& result : results)
+	{
+		const double thread_time = std::max(result.env_count * result.duration, 1e-9);
+		auto percent = [&](double time) { return 100.0 * time / thread_time; };
+		const double frames_per_second = static_cast<double>(result.frames) / result.duration;
+		peak = std::max(peak, frames_per_second);
+		spdlog::fmt_lib::print(
+			"{:>5} {:>12.0f} {:>12.0f} {:>9.1f}% {:>9.1f}% {:>7.1f}% {:>6.1f}%{} {:>9.1f}% {:>7.1f}%\n",
+			result.env_count,
+			static_cast<double>(result.steps) / result.duration,
+			frames_per_second,
+			percent(result.emulation),
+			percent(result.preprocessing),
+			percent(result.reset),
+			percent(result.policy),
+			result.policy_measured ? " " : "*",
+			percent(result.callbacks),
+			percent(result.other));
+	}
+	if (!results.front().policy_measured)
+	{
+		spdlog::fmt_lib::print(
+			"* policy is the time the envs waited for their actions, including inference, training and agent overhead\n");
+	}
+
+	int knee = std::numeric_limits<int>::max();
+	for (const auto& result : results)
+	{
+		if (static_cast<double>(result.frames) / result.duration >= 0.9 * peak)
+		{
+			knee = std::min(knee, result.env_count);
+		}
+	}
+	spdlog::fmt_lib::print("Throughput knee: {} envs reach 90% of the peak {:.0f} frames/s\n", knee, peak);
+}
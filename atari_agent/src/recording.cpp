@@ -0,0 +1,70 @@
+#include "recording.h"
+
+#include "serialise.h"
+
+#include <nlohmann/json.hpp>
+#include <spdlog/spdlog.h>
+
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+
+using namespace atari;
+
+namespace
+{
+
+constexpr int kRecordingVersion = 1;
+
+} // namespace
+
+void atari::save_recording(const std::filesystem::path& path, const EpisodeRecording& recording)
+{
+	nlohmann::json json;
+	json["version"] = kRecordingVersion;
+	json["rom_md5"] = recording.rom_md5;
+	json["env"] = recording.env;
+	json["game_seed"] = recording.game_seed;
+	json["repeat_action_probability"] = recording.repeat_action_probability;
+	json["start_state"] = nlohmann::json::binary(
+		std::vector<uint8_t>(recording.start_state.begin(), recording.start_state.end()));
+	json["noop_frames"] = recording.noop_frames;
+	json["actions"] = nlohmann::json::binary(recording.actions);
+	json["score"] = recording.score;
+
+	std::ofstream file(path, std::ios::binary);
+	if (!file.is_open())
+	{
+		spdlog::error("Unable to open '{}' to save the recording", path.string());
+		throw std::runtime_error("Unable to open the recording file");
+	}
+	nlohmann::json::to_cbor(json, file);
+}
+
+EpisodeRecording atari::load_recording(const std::filesystem::path& path)
+{
+	std::ifstream file(path, std::ios::binary);
+	if (!file.is_open())
+	{
+		spdlog::error("Unable to open the recording '{}'", path.string());
+		throw std::runtime_error("Unable to open the recording file");
+	}
+	auto json = nlohmann::json::from_cbor(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+	if (json.value("version", 0) != kRecordingVersion)
+	{
+		spdlog::error("The recording '{}' has an unsupported version", path.string());
+		throw std::invalid_argument("Unsupported recording version");
+	}
+
+	EpisodeRecording recording;
+	recording.rom_md5 = json.at("rom_md5").get<std::string>();
+	recording.env = json.at("env").get<Config::AtariEnv>();
+	recording.game_seed = json.at("game_seed").get<int>();
+	recording.repeat_action_probability = json.at("repeat_action_probability").get<float>();
+	const auto& start_state = json.at("start_state").get_binary();
+	recording.start_state.assign(start_state.begin(), start_state.end());
+	recording.noop_frames = json.at("noop_frames").get<int>();
+	recording.actions = json.at("actions").get_binary();
+	recording.score = json.at("score").get<float>();
+	return recording;
+}
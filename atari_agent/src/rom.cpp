@@ -0,0 +1,45 @@
+#include "rom.h"
+
+#include <ale_interface.hpp>
+#include <spdlog/spdlog.h>
+
+#include <map>
+#include <mutex>
+#include <stdexcept>
+
+using namespace atari;
+
+namespace
+{
+
+std::mutex m_roms;
+// Keyed by the absolute path, so the same ROM is shared even if the working directory changes. Map nodes are never
+// moved, so references to validated ROMs remain valid as others are added.
+std::map<std::filesystem::path, Rom> roms;
+
+} // namespace
+
+const Rom& atari::validate_rom(const std::filesystem::path& rom_file)
+{
+	auto path = std::filesystem::absolute(rom_file).lexically_normal();
+	// Held while validating, so concurrent first uses of a ROM only validate it once
+	std::lock_guard lock(m_roms);
+	if (auto iter = roms.find(path); iter != roms.end())
+	{
+		return iter->second;
+	}
+
+	if (!std::filesystem::is_regular_file(path))
+	{
+		spdlog::error("The ROM file '{}' does not exist", path.string());
+		throw std::invalid_argument("ROM file not found");
+	}
+	auto md5 = ale::ALEInterface::isSupportedROM(path);
+	if (!md5)
+	{
+		spdlog::error("The ROM file '{}' is not a ROM supported by the emulator", path.string());
+		throw std::invalid_argument("Unsupported ROM file");
+	}
+	spdlog::debug("Validated ROM '{}' with MD5 {}", path.string(), *md5);
+	return roms.emplace(path, Rom{path, *md5}).first->second;
+}
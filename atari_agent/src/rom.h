@@ -0,0 +1,26 @@
+#pragma once
+
+#include <filesystem>
+#include <string>
+
+namespace atari
+{
+
+/// @brief A ROM file which has been validated as a ROM supported by the emulator
+struct Rom
+{
+	// The absolute path of the ROM file
+	std::filesystem::path path;
+	// The MD5 hash of the ROM's contents, which identifies the game
+	std::string md5;
+};
+
+/// @brief Validates a ROM the first time it is used, so a missing or unsupported ROM is reported once before any
+/// emulator is created. The result is kept for the life of the process, so environments created later, from any
+/// thread, don't validate it again. The ROM's contents are not kept, as the emulator can only load a ROM from a file,
+/// so every emulator still reads the file as it loads it.
+/// @param rom_file The path of the ROM file. Relative paths are relative to the current working directory.
+/// @return The ROM, which remains valid for the life of the process
+const Rom& validate_rom(const std::filesystem::path& rom_file);
+
+} // namespace atari
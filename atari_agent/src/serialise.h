@@ -15,42 +15,81 @@ namespace atari
 namespace Config
 {
 
+NLOHMANN_JSON_SERIALIZE_ENUM(
+	ObservationMode,
+	{
+		{ObservationMode::kPixels, "pixels"},
+		{ObservationMode::kRAM, "ram"},
+		{ObservationMode::kPixelsAndRAM, "pixels_and_ram"},
+	})
+
 static inline void from_json(const nlohmann::json& json, Config::AtariEnv& env)
 {
 	env.rom_file << required_input{json, "rom_file"};
+	env.seed << optional_input{json, "seed"};
 	env.end_episode_on_life_loss << optional_input{json, "end_episode_on_life_loss"};
 	env.clip_reward << optional_input{json, "clip_reward"};
 	env.frame_skip << optional_input{json, "frame_skip"};
 	env.noop_reset_max_frames << optional_input{json, "noop_reset_max_frames"};
+	env.reset_state_bank_size << optional_input{json, "reset_state_bank_size"};
+	env.reset_ahead << optional_input{json, "reset_ahead"};
+	env.record_episodes << optional_input{json, "record_episodes"};
+	env.observation_mode << optional_input{json, "observation_mode"};
 	env.frame_stack << optional_input{json, "frame_stack"};
 	env.frame_stack = std::max(env.frame_stack, 1);
 	env.grayscale << optional_input{json, "grayscale"};
 	env.output_resolution << optional_input{json, "output_resolution"};
 	env.use_float << optional_input{json, "use_float"};
+	env.indexed_visualisations << optional_input{json, "indexed_visualisations"};
+	env.construction_thread_count << optional_input{json, "construction_thread_count"};
+	env.cpu_affinity << optional_input{json, "cpu_affinity"};
 }
 
 static inline void to_json(nlohmann::json& json, const Config::AtariEnv& env)
 {
 	json["rom_file"] = env.rom_file;
+	json["seed"] = env.seed;
 	json["end_episode_on_life_loss"] = env.end_episode_on_life_loss;
 	json["clip_reward"] = env.clip_reward;
 	json["frame_skip"] = env.frame_skip;
 	json["noop_reset_max_frames"] = env.noop_reset_max_frames;
+	json["reset_state_bank_size"] = env.reset_state_bank_size;
+	json["reset_ahead"] = env.reset_ahead;
+	json["record_episodes"] = env.record_episodes;
+	json["observation_mode"] = env.observation_mode;
 	json["frame_stack"] = env.frame_stack;
 	json["grayscale"] = env.grayscale;
 	json["output_resolution"] = env.output_resolution;
 	json["use_float"] = env.use_float;
+	json["indexed_visualisations"] = env.indexed_visualisations;
+	json["construction_thread_count"] = env.construction_thread_count;
+	json["cpu_affinity"] = env.cpu_affinity;
 }
 
 } // namespace Config
 
+NLOHMANN_JSON_SERIALIZE_ENUM(
+	LogBackpressure,
+	{
+		{LogBackpressure::kBlock, "block"},
+		{LogBackpressure::kDrop, "drop"},
+		{LogBackpressure::kSample, "sample"},
+	})
+
 static inline void from_json(const nlohmann::json& json, ConfigData& config)
 {
 	config.env << required_input{json, "environment"};
 	config.agent << required_input{json, "agent"};
 	config.observation_save_period << optional_input{json, "observation_save_period"};
 	config.observation_gif_save_period << optional_input{json, "observation_gif_save_period"};
+	config.gif_frame_decimation << optional_input{json, "gif_frame_decimation"};
+	config.stream_gifs << optional_input{json, "stream_gifs"};
 	config.metric_image_log_period << optional_input{json, "metric_image_log_period"};
+	config.log_queue_size << optional_input{json, "log_queue_size"};
+	config.log_queue_size = std::max(config.log_queue_size, 1);
+	config.log_backpressure << optional_input{json, "log_backpressure"};
+	config.log_sample_interval << optional_input{json, "log_sample_interval"};
+	config.log_sample_interval = std::max(config.log_sample_interval, 1);
 }
 
 static inline void to_json(nlohmann::json& json, const ConfigData& config)
@@ -59,7 +98,12 @@ static inline void to_json(nlohmann::json& json, const ConfigData& config)
 	json["agent"] = config.agent;
 	json["observation_save_period"] = config.observation_save_period;
 	json["observation_gif_save_period"] = config.observation_gif_save_period;
+	json["gif_frame_decimation"] = config.gif_frame_decimation;
+	json["stream_gifs"] = config.stream_gifs;
 	json["metric_image_log_period"] = config.metric_image_log_period;
+	json["log_queue_size"] = config.log_queue_size;
+	json["log_backpressure"] = config.log_backpressure;
+	json["log_sample_interval"] = config.log_sample_interval;
 }
 
 static inline void from_json(const nlohmann::json& json, EnvState& state)
@@ -0,0 +1,63 @@
+#include "snapshot.h"
+
+using namespace atari;
+
+namespace
+{
+
+// Copies a frame stack into a snapshot's stack, reusing its storage when it exists
+void copy_stack(std::unique_ptr<FrameStack>& dst, const FrameStack* src)
+{
+	if (src == nullptr)
+	{
+		dst.reset();
+	}
+	else if (dst)
+	{
+		dst->copy_from(*src);
+	}
+	else
+	{
+		dst = std::make_unique<FrameStack>(*src);
+	}
+}
+
+} // namespace
+
+void SnapshotRecycler::operator()(AtariSnapshot* snapshot) const
+{
+	if (pool)
+	{
+		pool->release(snapshot);
+	}
+	else
+	{
+		delete snapshot;
+	}
+}
+
+SnapshotHandle SnapshotPool::acquire(const FrameStack* frame_stack, const FrameStack* ram_stack)
+{
+	std::unique_ptr<AtariSnapshot> snapshot;
+	{
+		std::lock_guard lock(m_free_);
+		if (!free_.empty())
+		{
+			snapshot = std::move(free_.back());
+			free_.pop_back();
+		}
+	}
+	if (!snapshot)
+	{
+		snapshot = std::make_unique<AtariSnapshot>();
+	}
+	copy_stack(snapshot->frame_stack, frame_stack);
+	copy_stack(snapshot->ram_stack, ram_stack);
+	return SnapshotHandle(snapshot.release(), SnapshotRecycler{shared_from_this()});
+}
+
+void SnapshotPool::release(AtariSnapshot* snapshot)
+{
+	std::lock_guard lock(m_free_);
+	free_.emplace_back(snapshot);
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include "configuration.h"
+#include "frame_stack.h"
+
+#include <ale_interface.hpp>
+
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace atari
+{
+
+/// @brief A snapshot of the full state of an Atari environment, which can be restored to return to this state without
+/// re-emulating from a reset.
+struct AtariSnapshot
+{
+	ale::ALEState ale_state;
+	// The stacked pixel frames, null when pixels are not observed
+	std::unique_ptr<FrameStack> frame_stack;
+	// The stacked RAM, null when the RAM is not observed
+	std::unique_ptr<FrameStack> ram_stack;
+	EnvState state;
+	int step = 0;
+	bool episode_end = false;
+	int max_episode_steps = 0;
+};
+
+class SnapshotPool;
+
+/// @brief Returns a snapshot to its pool when the snapshot handle is destroyed
+struct SnapshotRecycler
+{
+	std::shared_ptr<SnapshotPool> pool;
+
+	void operator()(AtariSnapshot* snapshot) const;
+};
+
+using SnapshotHandle = std::unique_ptr<AtariSnapshot, SnapshotRecycler>;
+
+/// @brief A pool of snapshots. Released snapshots keep their frame stack storage, so taking a snapshot only copies
+/// into existing buffers rather than allocating new ones. Snapshots can be released from any thread.
+class SnapshotPool : public std::enable_shared_from_this<SnapshotPool>
+{
+public:
+	/// @brief Gets a snapshot from the pool, creating a new one if none are free.
+	/// @param frame_stack The pixel frame stack to copy into the snapshot, or null if pixels are not observed
+	/// @param ram_stack The RAM frame stack to copy into the snapshot, or null if the RAM is not observed
+	/// @return The snapshot handle, which returns the snapshot to the pool when destroyed
+	SnapshotHandle acquire(const FrameStack* frame_stack, const FrameStack* ram_stack);
+
+	/// @brief Returns a snapshot to the pool
+	/// @param snapshot The snapshot to return
+	void release(AtariSnapshot* snapshot);
+
+private:
+	std::mutex m_free_;
+	std::vector<std::unique_ptr<AtariSnapshot>> free_;
+};
+
+} // namespace atari
@@ -0,0 +1,9 @@
+#include "statistics.h"
+
+using namespace atari;
+
+EnvStatistics& atari::env_statistics()
+{
+	static EnvStatistics statistics;
+	return statistics;
+}
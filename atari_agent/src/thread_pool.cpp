@@ -0,0 +1,104 @@
+#include "thread_pool.h"
+
+#include <algorithm>
+#include <cstdint>
+
+using namespace atari;
+
+ThreadPool::ThreadPool(int thread_count)
+{
+	if (thread_count <= 0)
+	{
+		thread_count = std::max<int>(std::thread::hardware_concurrency(), 1);
+	}
+	workers_.reserve(thread_count);
+	for (int i = 0; i < thread_count; ++i)
+	{
+		auto& worker = workers_.emplace_back(std::make_unique<Worker>());
+		worker->thread = std::thread(&ThreadPool::run, this, std::ref(*worker));
+	}
+}
+
+ThreadPool::~ThreadPool()
+{
+	for (auto& worker : workers_)
+	{
+		{
+			std::lock_guard lock(worker->m_tasks);
+			worker->stop = true;
+		}
+		worker->cv_tasks.notify_one();
+	}
+	for (auto& worker : workers_) { worker->thread.join(); }
+}
+
+int ThreadPool::size() const
+{
+	return static_cast<int>(workers_.size());
+}
+
+void ThreadPool::submit(int worker, std::function<void()> task)
+{
+	auto& w = *workers_.at(worker);
+	{
+		std::lock_guard lock(w.m_tasks);
+		w.tasks.push_back(std::move(task));
+	}
+	w.cv_tasks.notify_one();
+}
+
+void ThreadPool::parallel_for(int count, const std::function<void(int)>& fn)
+{
+	const int workers = size();
+	// The block of indices for worker w, where worker_for(index) == w
+	auto block_begin = [&](int w) { return (w * count + workers - 1) / workers; };
+	int remaining = 0;
+	for (int w = 0; w < workers; ++w) { remaining += block_begin(w) < block_begin(w + 1) ? 1 : 0; }
+
+	std::mutex m_done;
+	std::condition_variable cv_done;
+	for (int w = 0; w < workers; ++w)
+	{
+		int begin = block_begin(w);
+		int end = block_begin(w + 1);
+		if (begin >= end)
+		{
+			continue;
+		}
+		submit(w, [&, begin, end]() {
+			for (int i = begin; i < end; ++i) { fn(i); }
+			std::lock_guard lock(m_done);
+			if (--remaining == 0)
+			{
+				cv_done.notify_one();
+			}
+		});
+	}
+
+	std::unique_lock lock(m_done);
+	cv_done.wait(lock, [&] { return remaining == 0; });
+}
+
+int ThreadPool::worker_for(int index, int count) const
+{
+	return static_cast<int>((static_cast<int64_t>(index) * size()) / count);
+}
+
+void ThreadPool::run(Worker& worker)
+{
+	while (true)
+	{
+		std::function<void()> task;
+		{
+			std::unique_lock lock(worker.m_tasks);
+			worker.cv_tasks.wait(lock, [&] { return worker.stop || !worker.tasks.empty(); });
+			if (worker.tasks.empty())
+			{
+				return;
+			}
+			task = std::move(worker.tasks.front());
+			worker.tasks.pop_front();
+		}
+		task();
+	}
+}
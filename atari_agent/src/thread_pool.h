@@ -0,0 +1,59 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace atari
+{
+
+/// @brief A fixed size pool of worker threads, each with its own task queue. Work is assigned to workers statically so
+/// the same index (i.e. environment) is always processed by the same worker, keeping its data local to that worker.
+class ThreadPool
+{
+public:
+	/// @brief Creates the pool and starts the worker threads
+	/// @param thread_count The number of worker threads. Values <= 0 use the number of hardware threads.
+	explicit ThreadPool(int thread_count);
+	~ThreadPool();
+
+	/// @brief The number of worker threads
+	int size() const;
+
+	/// @brief Queues a task to run on a specific worker. Tasks on the same worker run in the order they are submitted.
+	/// @param worker The index of the worker to run the task on
+	/// @param task The task to run
+	void submit(int worker, std::function<void()> task);
+
+	/// @brief Runs fn for each index in [0, count), blocking until all have completed. The indices are split into
+	/// contiguous blocks, one per worker, as defined by worker_for().
+	/// @param count The number of indices
+	/// @param fn The function to run for each index
+	void parallel_for(int count, const std::function<void(int)>& fn);
+
+	/// @brief The worker an index is assigned to when splitting count indices over the workers
+	/// @param index The index to get the worker for
+	/// @param count The total number of indices
+	/// @return The worker index
+	int worker_for(int index, int count) const;
+
+private:
+	struct Worker
+	{
+		std::thread thread;
+		std::mutex m_tasks;
+		std::condition_variable cv_tasks;
+		std::deque<std::function<void()>> tasks;
+		bool stop = false;
+	};
+
+	void run(Worker& worker);
+
+	std::vector<std::unique_ptr<Worker>> workers_;
+};
+
+} // namespace atari
@@ -0,0 +1,175 @@
+#include "trace.h"
+
+#include <spdlog/spdlog.h>
+
+#include <atomic>
+#include <fstream>
+#include <memory>
+#include <stdexcept>
+#include <vector>
+
+using namespace atari;
+
+namespace
+{
+
+// The events each thread can record in a window, 2MB per thread. Later events are dropped once a thread's buffer is
+// full.
+constexpr size_t kEventsPerThread = 1 << 16;
+
+struct TraceEvent
+{
+	const char* name;
+	const char* category;
+	int64_t start_ns;
+	int64_t end_ns;
+};
+
+// The events of a single thread. Only the owning thread appends, publishing each event by incrementing the count, so
+// the recorder can read the published events without locking or racing the thread. Events are never overwritten.
+struct ThreadEvents
+{
+	int id = 0;
+	std::unique_ptr<TraceEvent[]> events = std::make_unique<TraceEvent[]>(kEventsPerThread);
+	std::atomic<size_t> count{0};
+	std::atomic<uint64_t> dropped{0};
+};
+
+std::atomic<bool> recorder_exists{false};
+std::atomic<bool> recording{false};
+std::atomic<int64_t> window_start_ns{0};
+
+// The events of all threads which have recorded. Kept until the process exits, as threads hold a pointer to theirs.
+std::mutex m_threads;
+std::vector<std::unique_ptr<ThreadEvents>> threads;
+
+ThreadEvents& thread_events()
+{
+	thread_local ThreadEvents* events = [] {
+		std::lock_guard lock(m_threads);
+		auto& thread = threads.emplace_back(std::make_unique<ThreadEvents>());
+		thread->id = static_cast<int>(threads.size());
+		return thread.get();
+	}();
+	return *events;
+}
+
+std::chrono::steady_clock::duration to_duration(double seconds)
+{
+	return std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(seconds));
+}
+
+int64_t now_ns()
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch())
+		.count();
+}
+
+} // namespace
+
+TraceRecorder::TraceRecorder(std::filesystem::path path, double delay, double duration) : path_(std::move(path))
+{
+	if (recorder_exists.exchange(true))
+	{
+		spdlog::error("Only one trace can be recorded per process");
+		throw std::runtime_error("A trace has already been recorded");
+	}
+	const auto start = std::chrono::steady_clock::now() + to_duration(delay);
+	thread_ = std::thread(&TraceRecorder::run, this, start, to_duration(duration));
+}
+
+TraceRecorder::~TraceRecorder()
+{
+	{
+		std::lock_guard lock(m_stop_);
+		stop_ = true;
+	}
+	cv_stop_.notify_one();
+	thread_.join();
+}
+
+void TraceRecorder::run(std::chrono::steady_clock::time_point start, std::chrono::steady_clock::duration duration)
+{
+	{
+		std::unique_lock lock(m_stop_);
+		if (!cv_stop_.wait_until(lock, start, [this] { return stop_; }))
+		{
+			window_start_ns = now_ns();
+			recording = true;
+			spdlog::info("Tracing for {:.1f}s", std::chrono::duration<double>(duration).count());
+			cv_stop_.wait_until(lock, start + duration, [this] { return stop_; });
+			recording = false;
+		}
+	}
+	try
+	{
+		write();
+	}
+	catch (const std::exception& e)
+	{
+		spdlog::error("Failed to write the trace to '{}': {}", path_.string(), e.what());
+	}
+}
+
+void TraceRecorder::write() const
+{
+	std::ofstream file(path_);
+	if (!file.is_open())
+	{
+		throw std::runtime_error("Unable to open the trace file");
+	}
+
+	// Timestamps are in microseconds from the start of the window
+	const int64_t origin = window_start_ns;
+	size_t event_count = 0;
+	uint64_t dropped = 0;
+	file << R"({"displayTimeUnit":"ms","traceEvents":[)";
+	std::lock_guard lock(m_threads);
+	for (const auto& thread : threads)
+	{
+		const size_t count = thread->count.load(std::memory_order_acquire);
+		for (size_t i = 0; i < count; ++i)
+		{
+			const auto& event = thread->events[i];
+			file << (event_count++ > 0 ? ",\n" : "\n")
+					 << spdlog::fmt_lib::format(
+								R"({{"name":"{}","cat":"{}","ph":"X","ts":{:.3f},"dur":{:.3f},"pid":1,"tid":{}}})",
+								event.name,
+								event.category,
+								static_cast<double>(event.start_ns - origin) / 1e3,
+								static_cast<double>(event.end_ns - event.start_ns) / 1e3,
+								thread->id);
+		}
+		dropped += thread->dropped.load(std::memory_order_relaxed);
+	}
+	file << "\n]}\n";
+
+	if (dropped > 0)
+	{
+		spdlog::warn("{} trace events were dropped as a thread's buffer was full", dropped);
+	}
+	spdlog::info("Trace of {} events saved to: {}", event_count, path_.string());
+}
+
+bool atari::is_tracing()
+{
+	return recording.load(std::memory_order_relaxed);
+}
+
+void atari::trace_event(const char* name, const char* category, int64_t start_ns, int64_t end_ns)
+{
+	// Spans still open as the window closes are dropped
+	if (!recording.load(std::memory_order_relaxed))
+	{
+		return;
+	}
+	auto& thread = thread_events();
+	const size_t count = thread.count.load(std::memory_order_relaxed);
+	if (count >= kEventsPerThread)
+	{
+		thread.dropped.store(thread.dropped.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+		return;
+	}
+	thread.events[count] = {name, category, start_ns, end_ns};
+	thread.count.store(count + 1, std::memory_order_release);
+}
@@ -0,0 +1,247 @@
+#include "vector_env.h"
+
+#include "affinity.h"
+#include "atari_env.h"
+#include "thread_pool.h"
+
+#include <algorithm>
+#include <exception>
+#include <numeric>
+#include <stdexcept>
+#include <thread>
+
+using namespace atari;
+
+AtariVectorEnv::AtariVectorEnv(const Config::AtariEnv& config, const VectorEnvOptions& options)
+		: config_(config), max_episode_steps_(options.max_episode_steps)
+{
+	const int env_count = options.env_count;
+	if (env_count < 1)
+	{
+		throw std::invalid_argument("A vector environment requires at least 1 environment");
+	}
+	if (config_.observation_mode == Config::ObservationMode::kPixelsAndRAM)
+	{
+		throw std::invalid_argument("A vector environment only supports a single observation, either pixels or RAM");
+	}
+	int thread_count = options.thread_count;
+	if (thread_count <= 0)
+	{
+		thread_count = static_cast<int>(std::thread::hardware_concurrency());
+	}
+	thread_pool_ = std::make_unique<ThreadPool>(std::clamp(thread_count, 1, env_count));
+	batch_size_ = options.batch_size > 0 ? std::min(options.batch_size, env_count) : env_count;
+
+	// Each worker is pinned before creating the environments it steps, so their memory is allocated on its NUMA node
+	if (!config_.cpu_affinity.empty())
+	{
+		for (int w = 0; w < thread_pool_->size(); ++w)
+		{
+			thread_pool_->submit(w, [this, w]() { pin_thread(env_cpu_set(config_, w)); });
+		}
+	}
+
+	// Each environment is created by the worker which steps it
+	envs_.resize(env_count);
+	std::vector<std::exception_ptr> errors(env_count);
+	thread_pool_->parallel_for(env_count, [&](int i) {
+		try
+		{
+			envs_[i] = std::make_unique<Atari>(config_, i);
+		}
+		catch (...)
+		{
+			errors[i] = std::current_exception();
+		}
+	});
+	for (auto& error : errors)
+	{
+		if (error)
+		{
+			std::rethrow_exception(error);
+		}
+	}
+
+	observation_shape_ = envs_.front()->observation_shape();
+	observation_dtype_ = envs_.front()->observation_dtype();
+
+	std::vector<int64_t> shape = {env_count};
+	shape.insert(shape.end(), observation_shape_.begin(), observation_shape_.end());
+	env_observations_ = torch::empty(shape, observation_dtype_);
+	for (int i = 0; i < env_count; ++i) { env_observation_slots_.push_back(env_observations_[i]); }
+	// Zeroed by the workers, so each environment's observation is first touched on its worker's NUMA node
+	thread_pool_->parallel_for(env_count, [&](int i) { env_observation_slots_[i].zero_(); });
+	env_rewards_.resize(env_count, 0.0F);
+	env_episode_ends_.resize(env_count, false);
+	env_pending_.resize(env_count, false);
+	completed_.reserve(env_count);
+}
+
+AtariVectorEnv::~AtariVectorEnv()
+{
+	// Stop the workers before the environments they step are destroyed
+	thread_pool_.reset();
+}
+
+VectorStepData AtariVectorEnv::reset()
+{
+	auto step_data = allocate_step_data(size());
+	step_data.reward.zero_();
+	step_data.episode_end.zero_();
+	auto* env_ids = step_data.env_id.data_ptr<int64_t>();
+	std::iota(env_ids, env_ids + size(), 0);
+	thread_pool_->parallel_for(size(), [&](int i) { envs_[i]->reset(max_episode_steps_, step_data.observation[i]); });
+	return step_data;
+}
+
+VectorStepData AtariVectorEnv::step(const torch::Tensor& actions)
+{
+	if (actions.numel() != size())
+	{
+		throw std::invalid_argument("The number of actions must match the number of environments");
+	}
+	auto action_indices = actions.cpu().to(torch::kLong).contiguous();
+	const int64_t* action_data = action_indices.data_ptr<int64_t>();
+
+	auto step_data = allocate_step_data(size());
+	auto* env_ids = step_data.env_id.data_ptr<int64_t>();
+	auto* rewards = step_data.reward.data_ptr<float>();
+	auto* episode_ends = step_data.episode_end.data_ptr<bool>();
+	std::iota(env_ids, env_ids + size(), 0);
+	thread_pool_->parallel_for(size(), [&](int i) {
+		auto& env = *envs_[i];
+		auto observation = step_data.observation[i];
+		rewards[i] = env.step(static_cast<int>(action_data[i]), observation);
+		episode_ends[i] = env.is_episode_end();
+		if (episode_ends[i])
+		{
+			env.reset(max_episode_steps_, observation);
+		}
+	});
+	return step_data;
+}
+
+void AtariVectorEnv::async_reset()
+{
+	// A negative action indicates a reset
+	for (int i = 0; i < size(); ++i) { submit(i, -1); }
+}
+
+void AtariVectorEnv::send(const torch::Tensor& actions, const torch::Tensor& env_ids)
+{
+	if (actions.numel() != env_ids.numel())
+	{
+		throw std::invalid_argument("The number of actions must match the number of environment ids");
+	}
+	auto action_indices = actions.cpu().to(torch::kLong).contiguous();
+	auto ids = env_ids.cpu().to(torch::kLong).contiguous();
+	const int64_t* action_data = action_indices.data_ptr<int64_t>();
+	const int64_t* id_data = ids.data_ptr<int64_t>();
+	for (int64_t i = 0; i < ids.numel(); ++i) { submit(static_cast<int>(id_data[i]), static_cast<int>(action_data[i])); }
+}
+
+VectorStepData AtariVectorEnv::recv()
+{
+	if (std::count(env_pending_.begin(), env_pending_.end(), true) < batch_size_)
+	{
+		throw std::logic_error("Fewer environments have been sent actions than the batch size");
+	}
+
+	std::vector<int> ids(batch_size_);
+	{
+		std::unique_lock lock(m_completed_);
+		cv_completed_.wait(lock, [&] { return static_cast<int>(completed_.size()) >= batch_size_; });
+		std::copy_n(completed_.begin(), batch_size_, ids.begin());
+		completed_.erase(completed_.begin(), completed_.begin() + batch_size_);
+	}
+
+	auto step_data = allocate_step_data(batch_size_);
+	auto* env_ids = step_data.env_id.data_ptr<int64_t>();
+	auto* rewards = step_data.reward.data_ptr<float>();
+	auto* episode_ends = step_data.episode_end.data_ptr<bool>();
+	for (int b = 0; b < batch_size_; ++b)
+	{
+		const int id = ids[b];
+		env_ids[b] = id;
+		rewards[b] = env_rewards_[id];
+		episode_ends[b] = env_episode_ends_[id];
+		step_data.observation[b].copy_(env_observation_slots_[id]);
+		env_pending_[id] = false;
+	}
+	return step_data;
+}
+
+int AtariVectorEnv::size() const
+{
+	return static_cast<int>(envs_.size());
+}
+
+int AtariVectorEnv::batch_size() const
+{
+	return batch_size_;
+}
+
+drla::EnvironmentConfiguration AtariVectorEnv::get_configuration() const
+{
+	return envs_.front()->get_configuration();
+}
+
+void AtariVectorEnv::submit(int env_id, int action)
+{
+	if (env_pending_.at(env_id))
+	{
+		throw std::logic_error("The environment has a pending step which has not been received");
+	}
+	env_pending_[env_id] = true;
+
+	thread_pool_->submit(thread_pool_->worker_for(env_id, size()), [this, env_id, action]() {
+		auto& env = *envs_[env_id];
+		const auto& observation = env_observation_slots_[env_id];
+		if (action < 0)
+		{
+			env.reset(max_episode_steps_, observation);
+			env_rewards_[env_id] = 0.0F;
+			env_episode_ends_[env_id] = false;
+		}
+		else
+		{
+			env_rewards_[env_id] = env.step(action, observation);
+			env_episode_ends_[env_id] = env.is_episode_end();
+			if (env_episode_ends_[env_id])
+			{
+				env.reset(max_episode_steps_, observation);
+			}
+		}
+		{
+			std::lock_guard lock(m_completed_);
+			completed_.push_back(env_id);
+		}
+		cv_completed_.notify_one();
+	});
+}
+
+VectorStepData AtariVectorEnv::allocate_step_data(int count) const
+{
+	const int64_t batch = count;
+	int64_t observation_bytes = batch * static_cast<int64_t>(c10::elementSize(observation_dtype_));
+	for (auto dim : observation_shape_) { observation_bytes *= dim; }
+	// The env ids, rewards, observations and episode ends are packed into one allocation, ordered by decreasing alignment
+	const int64_t reward_offset = batch * static_cast<int64_t>(sizeof(int64_t));
+	const int64_t observation_offset = reward_offset + batch * static_cast<int64_t>(sizeof(float));
+	const int64_t episode_end_offset = observation_offset + observation_bytes;
+	auto buffer = torch::empty({episode_end_offset + batch}, torch::kByte);
+	auto* data = buffer.data_ptr<uint8_t>();
+	// Each view holds a reference to the buffer, keeping it alive as long as any view is in use
+	auto keep_alive = [buffer](void*) {};
+
+	std::vector<int64_t> shape = {batch};
+	shape.insert(shape.end(), observation_shape_.begin(), observation_shape_.end());
+
+	VectorStepData step_data;
+	step_data.env_id = torch::from_blob(data, {batch}, keep_alive, torch::kLong);
+	step_data.reward = torch::from_blob(data + reward_offset, {batch}, keep_alive, torch::kFloat);
+	step_data.observation =
+		torch::from_blob(data + observation_offset, shape, keep_alive, torch::TensorOptions(observation_dtype_));
+	step_data.episode_end = torch::from_blob(data + episode_end_offset, {batch}, keep_alive, torch::kBool);
+	return step_data;
+}
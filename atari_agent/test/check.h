@@ -0,0 +1,50 @@
+#pragma once
+
+#include <spdlog/spdlog.h>
+
+#include <filesystem>
+#include <string>
+
+namespace atari::test
+{
+
+/// @brief The exit code of a test which can't run, such as an environment test without a ROM. CTest reports it as
+/// skipped.
+inline constexpr int kSkipped = 77;
+
+inline int& failure_count()
+{
+	static int count = 0;
+	return count;
+}
+
+/// @brief Logs and counts the failure if the condition is false
+/// @param condition The condition which should hold
+/// @param description A description of what was checked, logged on failure
+inline void check(bool condition, const std::string& description)
+{
+	if (!condition)
+	{
+		spdlog::error("Check failed: {}", description);
+		++failure_count();
+	}
+}
+
+/// @brief The exit code of the test, which fails if any check failed
+inline int result()
+{
+	if (failure_count() > 0)
+	{
+		spdlog::error("{} checks failed", failure_count());
+		return 1;
+	}
+	return 0;
+}
+
+/// @brief The ROM passed as the test's first argument, empty if none was given
+inline std::filesystem::path test_rom(int argc, char** argv)
+{
+	return argc > 1 ? std::filesystem::absolute(argv[1]) : std::filesystem::path{};
+}
+
+} // namespace atari::test
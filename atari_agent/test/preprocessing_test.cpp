@@ -0,0 +1,126 @@
+#include "check.h"
+#include "preprocessing.h"
+
+#include <spdlog/spdlog.h>
+#include <torch/torch.h>
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <vector>
+
+using namespace atari;
+
+namespace
+{
+
+constexpr int kScreenHeight = 210;
+constexpr int kScreenWidth = 160;
+
+// The original observation pipeline, converting the screen to float and area interpolating it with torch before
+// converting back to bytes. Skipped frames were pooled with torch, which on raw screens is an element-wise max.
+torch::Tensor reference_observation(const Config::AtariEnv& config, torch::Tensor screen)
+{
+	const int channels = config.grayscale ? 1 : 3;
+	torch::Tensor obs = screen.permute({2, 0, 1});
+	if (config.output_resolution[0] > 0 || config.output_resolution[1] > 0)
+	{
+		int width = config.output_resolution[0] > 0 ? config.output_resolution[0] : kScreenWidth;
+		int height = config.output_resolution[1] > 0 ? config.output_resolution[1] : kScreenHeight;
+		obs = torch::nn::functional::interpolate(
+						obs.to(torch::kFloat).div(255.0F).view({1, channels, kScreenHeight, kScreenWidth}),
+						torch::nn::functional::InterpolateFuncOptions()
+							.size(torch::make_optional<std::vector<int64_t>>({height, width}))
+							.mode(torch::kArea))
+						.view({channels, height, width});
+		if (!config.use_float)
+		{
+			obs = (obs * 255.0F).to(torch::kByte);
+		}
+	}
+	else if (config.use_float)
+	{
+		obs = obs.to(torch::kFloat).div(255.0F);
+	}
+	return obs.contiguous();
+}
+
+const char* simd_name(SimdLevel simd_level)
+{
+	switch (simd_level)
+	{
+		case SimdLevel::kScalar: return "scalar";
+		case SimdLevel::kSSE2: return "sse2";
+		case SimdLevel::kAVX2: return "avx2";
+	}
+	return "unknown";
+}
+
+} // namespace
+
+int main()
+{
+	// The odd sizes leave a remainder after the vectorised columns, and a single resized dimension keeps the other
+	const std::vector<std::array<int, 2>> resolutions = {{0, 0}, {84, 84}, {61, 77}, {160, 0}, {0, 105}, {48, 64}};
+	std::vector<SimdLevel> simd_levels;
+	for (auto simd_level : {SimdLevel::kScalar, SimdLevel::kSSE2, SimdLevel::kAVX2})
+	{
+		if (simd_level <= detect_simd_level())
+		{
+			simd_levels.push_back(simd_level);
+		}
+	}
+
+	torch::manual_seed(0);
+	int cases = 0;
+	for (bool grayscale : {true, false})
+	{
+		const int channels = grayscale ? 1 : 3;
+		for (bool max_pool : {false, true})
+		{
+			for (const auto& resolution : resolutions)
+			{
+				for (bool use_float : {false, true})
+				{
+					Config::AtariEnv config;
+					config.grayscale = grayscale;
+					config.output_resolution = resolution;
+					config.use_float = use_float;
+
+					auto screen = torch::randint(256, {kScreenHeight, kScreenWidth, channels}, torch::kByte);
+					auto previous_screen = torch::randint(256, {kScreenHeight, kScreenWidth, channels}, torch::kByte);
+					auto expected = reference_observation(config, max_pool ? torch::max(screen, previous_screen) : screen);
+
+					for (auto simd_level : simd_levels)
+					{
+						FramePreprocessor preprocessor(config, kScreenHeight, kScreenWidth, simd_level);
+						auto pooled = screen.clone();
+						if (max_pool)
+						{
+							preprocessor.max_pool(previous_screen.data_ptr<uint8_t>(), pooled.data_ptr<uint8_t>());
+						}
+						// Filled with garbage so any element the pipeline doesn't write is detected
+						auto actual = torch::randint(256, expected.sizes(), torch::kByte).to(expected.scalar_type());
+						preprocessor.process(pooled.data_ptr<uint8_t>(), actual);
+
+						const auto description = spdlog::fmt_lib::format(
+							"{} max_pool={} resolution={}x{} float={} simd={} matches the torch pipeline",
+							grayscale ? "grayscale" : "rgb",
+							max_pool,
+							resolution[0],
+							resolution[1],
+							use_float,
+							simd_name(simd_level));
+						test::check(
+							actual.sizes() == expected.sizes() &&
+								std::memcmp(actual.data_ptr(), expected.data_ptr(), expected.nbytes()) == 0,
+							description);
+						++cases;
+					}
+				}
+			}
+		}
+	}
+	spdlog::info("Compared {} preprocessing cases", cases);
+	return test::result();
+}
@@ -0,0 +1,248 @@
+#include "atari_env.h"
+#include "check.h"
+
+#include <spdlog/spdlog.h>
+#include <torch/torch.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <new>
+#include <random>
+#include <set>
+
+using namespace atari;
+
+namespace
+{
+
+constexpr int kWarmupSteps = 100;
+constexpr int kSteps = 1000;
+
+std::atomic<int64_t> allocation_count{0};
+// Only allocations made by the test's thread while stepping are counted
+thread_local bool counting = false;
+
+void* allocate(std::size_t size)
+{
+	if (counting)
+	{
+		allocation_count.fetch_add(1, std::memory_order_relaxed);
+	}
+	if (void* ptr = std::malloc(size > 0 ? size : 1))
+	{
+		return ptr;
+	}
+	throw std::bad_alloc();
+}
+
+void* allocate_aligned(std::size_t size, std::align_val_t alignment)
+{
+	if (counting)
+	{
+		allocation_count.fetch_add(1, std::memory_order_relaxed);
+	}
+	const auto align = static_cast<std::size_t>(alignment);
+	if (void* ptr = std::aligned_alloc(align, (std::max<std::size_t>(size, 1) + align - 1) / align * align))
+	{
+		return ptr;
+	}
+	throw std::bad_alloc();
+}
+
+// Counts the allocations made by fn
+template <typename Fn>
+int64_t count_allocations(Fn&& fn)
+{
+	const int64_t start = allocation_count.load();
+	counting = true;
+	fn();
+	counting = false;
+	return allocation_count.load() - start;
+}
+
+// The allocations of building a drla step result from an environment's data, which are the only allocations a drla
+// step may make. drla::EnvStepData holds the observations and legal actions by value, so both vectors are copied, and
+// drla::State holds the EnvState in a std::any. EnvState holds the episode's recording, so it is too large for the
+// small object buffer of std::any and is always allocated.
+int64_t result_allocations(const drla::EnvStepData& data)
+{
+	drla::EnvStepData result;
+	const int64_t allocations = count_allocations([&] {
+		result = {data.observation, data.reward, {std::make_any<EnvState>(), 0, false, 0}, data.legal_actions};
+	});
+	test::check(result.legal_actions == data.legal_actions, "a step result copies the legal actions");
+	return allocations;
+}
+
+const char* mode_name(Config::ObservationMode mode)
+{
+	switch (mode)
+	{
+		case Config::ObservationMode::kPixels: return "pixels";
+		case Config::ObservationMode::kRAM: return "ram";
+		case Config::ObservationMode::kPixelsAndRAM: return "pixels_and_ram";
+	}
+	return "unknown";
+}
+
+// Steps writing into a caller supplied observation, which should not allocate at all
+void test_observation_step(const Config::AtariEnv& config, int action_count)
+{
+	Atari env(config);
+	auto observation = torch::empty(env.observation_shape(), env.observation_dtype());
+	env.reset(0, observation);
+	std::mt19937 rng(0);
+	std::uniform_int_distribution<int> dist(0, action_count - 1);
+
+	int64_t allocations = 0;
+	for (int step = 0; step < kWarmupSteps + kSteps; ++step)
+	{
+		const int action = dist(rng);
+		const int64_t step_allocations = count_allocations([&] { env.step(action, observation); });
+		allocations += step >= kWarmupSteps ? step_allocations : 0;
+		// Starting a new game allocates, so resets aren't counted
+		if (env.is_episode_end())
+		{
+			env.reset(0, observation);
+		}
+	}
+	const auto name = mode_name(config.observation_mode);
+	spdlog::info("{}: {} allocations in {} observation steps", name, allocations, kSteps);
+	test::check(
+		allocations == 0, spdlog::fmt_lib::format("{}: stepping into a supplied observation doesn't allocate", name));
+}
+
+// Steps via the drla interface, holding the latest step data like the agent does
+void test_drla_step(const Config::AtariEnv& config, int action_count)
+{
+	Atari env(config);
+	auto data = env.reset(drla::State{});
+	std::mt19937 rng(0);
+	std::uniform_int_distribution<int> dist(0, action_count - 1);
+	auto action = torch::zeros({1}, torch::kInt);
+	const int64_t allowed_allocations = result_allocations(data);
+
+	int64_t allocations = 0;
+	int64_t max_step_allocations = 0;
+	std::set<void*> observation_data;
+	for (int step = 0; step < kWarmupSteps + kSteps; ++step)
+	{
+		action[0] = dist(rng);
+		drla::EnvStepData next;
+		const int64_t step_allocations = count_allocations([&] { next = env.step(action); });
+		data = std::move(next);
+		if (step >= kWarmupSteps)
+		{
+			allocations += step_allocations;
+			max_step_allocations = std::max(max_step_allocations, step_allocations);
+			observation_data.insert(data.observation.front().data_ptr());
+		}
+		if (data.state.episode_end)
+		{
+			data = env.reset(drla::State{});
+		}
+	}
+	const auto name = mode_name(config.observation_mode);
+	spdlog::info(
+		"{}: {} allocations in {} drla steps, {} to build a step result",
+		name,
+		allocations,
+		kSteps,
+		allowed_allocations);
+	test::check(
+		max_step_allocations <= allowed_allocations,
+		spdlog::fmt_lib::format("{}: a drla step only allocates its result ({} allocations)", name, allowed_allocations));
+	// Resets return the same observation tensors, so alternating between two buffers covers every step
+	test::check(
+		observation_data.size() <= 2,
+		spdlog::fmt_lib::format("{}: drla steps alternate between two observation buffers", name));
+}
+
+} // namespace
+
+void* operator new(std::size_t size)
+{
+	return allocate(size);
+}
+
+void* operator new[](std::size_t size)
+{
+	return allocate(size);
+}
+
+void* operator new(std::size_t size, std::align_val_t alignment)
+{
+	return allocate_aligned(size, alignment);
+}
+
+void* operator new[](std::size_t size, std::align_val_t alignment)
+{
+	return allocate_aligned(size, alignment);
+}
+
+void operator delete(void* ptr) noexcept
+{
+	std::free(ptr);
+}
+
+void operator delete[](void* ptr) noexcept
+{
+	std::free(ptr);
+}
+
+void operator delete(void* ptr, std::size_t) noexcept
+{
+	std::free(ptr);
+}
+
+void operator delete[](void* ptr, std::size_t) noexcept
+{
+	std::free(ptr);
+}
+
+void operator delete(void* ptr, std::align_val_t) noexcept
+{
+	std::free(ptr);
+}
+
+void operator delete[](void* ptr, std::align_val_t) noexcept
+{
+	std::free(ptr);
+}
+
+void operator delete(void* ptr, std::size_t, std::align_val_t) noexcept
+{
+	std::free(ptr);
+}
+
+void operator delete[](void* ptr, std::size_t, std::align_val_t) noexcept
+{
+	std::free(ptr);
+}
+
+int main(int argc, char** argv)
+{
+	const auto rom = test::test_rom(argc, argv);
+	if (rom.empty())
+	{
+		spdlog::warn("No ROM given, skipping");
+		return test::kSkipped;
+	}
+
+	for (auto mode :
+			 {Config::ObservationMode::kPixels, Config::ObservationMode::kRAM, Config::ObservationMode::kPixelsAndRAM})
+	{
+		Config::AtariEnv config;
+		config.rom_file = rom.string();
+		config.seed = 0;
+		config.frame_skip = 4;
+		config.frame_stack = 4;
+		config.output_resolution = {84, 84};
+		config.observation_mode = mode;
+		const int action_count = static_cast<int>(Atari(config).get_configuration().action_set.size());
+		test_observation_step(config, action_count);
+		test_drla_step(config, action_count);
+	}
+	return test::result();
+}
@@ -0,0 +1,222 @@
+#include "atari_env.h"
+#include "check.h"
+#include "vector_env.h"
+
+#include <spdlog/spdlog.h>
+#include <torch/torch.h>
+
+#include <algorithm>
+#include <memory>
+#include <random>
+#include <set>
+#include <stdexcept>
+#include <vector>
+
+using namespace atari;
+
+namespace
+{
+
+constexpr int kEnvCount = 4;
+constexpr int kBatchSize = 2;
+constexpr int kSteps = 200;
+constexpr VectorEnvOptions kOptions = {kEnvCount, kBatchSize, 2};
+
+// Standalone copies of the vector environment's environments, stepped with the same actions to check each result is
+// returned against the id of the environment which produced it
+class ReferenceEnvs
+{
+public:
+	explicit ReferenceEnvs(const Config::AtariEnv& config)
+	{
+		for (int i = 0; i < kEnvCount; ++i)
+		{
+			envs_.push_back(std::make_unique<Atari>(config, i));
+			observations_.push_back(torch::empty(envs_.back()->observation_shape(), envs_.back()->observation_dtype()));
+		}
+	}
+
+	void reset(int env_id) { envs_[env_id]->reset(0, observations_[env_id]); }
+
+	// Steps the environment, resetting it at the end of an episode like the vector environment
+	void step(int env_id, int action, float& reward, bool& episode_end)
+	{
+		auto& env = *envs_[env_id];
+		reward = env.step(action, observations_[env_id]);
+		episode_end = env.is_episode_end();
+		if (episode_end)
+		{
+			env.reset(0, observations_[env_id]);
+		}
+	}
+
+	const torch::Tensor& observation(int env_id) const { return observations_[env_id]; }
+
+private:
+	std::vector<std::unique_ptr<Atari>> envs_;
+	std::vector<torch::Tensor> observations_;
+};
+
+void check_batch(
+	const VectorStepData& data,
+	const ReferenceEnvs& reference,
+	const std::vector<float>& rewards,
+	const std::vector<bool>& episode_ends,
+	const char* stage)
+{
+	const auto* env_ids = data.env_id.data_ptr<int64_t>();
+	for (int64_t b = 0; b < data.env_id.numel(); ++b)
+	{
+		const int id = static_cast<int>(env_ids[b]);
+		test::check(
+			torch::equal(data.observation[b], reference.observation(id)),
+			spdlog::fmt_lib::format("{}: the observation of env {} matches a standalone env", stage, id));
+		test::check(
+			data.reward[b].item<float>() == rewards[id],
+			spdlog::fmt_lib::format("{}: the reward of env {} matches a standalone env", stage, id));
+		test::check(
+			data.episode_end[b].item<bool>() == episode_ends[id],
+			spdlog::fmt_lib::format("{}: the episode end of env {} matches a standalone env", stage, id));
+	}
+}
+
+void test_sync(const Config::AtariEnv& config, int action_count)
+{
+	AtariVectorEnv vector_env(config, kOptions);
+	ReferenceEnvs reference(config);
+	std::vector<float> rewards(kEnvCount, 0.0F);
+	std::vector<bool> episode_ends(kEnvCount, false);
+
+	auto data = vector_env.reset();
+	for (int i = 0; i < kEnvCount; ++i) { reference.reset(i); }
+	test::check(data.env_id.numel() == kEnvCount, "reset returns every env");
+	test::check(
+		torch::equal(data.env_id, torch::arange(kEnvCount, torch::kLong)), "reset returns the envs ordered by env id");
+	check_batch(data, reference, rewards, episode_ends, "reset");
+
+	std::mt19937 rng(0);
+	std::uniform_int_distribution<int> dist(0, action_count - 1);
+	for (int step = 0; step < kSteps; ++step)
+	{
+		auto actions = torch::empty({kEnvCount}, torch::kLong);
+		for (int i = 0; i < kEnvCount; ++i)
+		{
+			const int action = dist(rng);
+			actions[i] = action;
+			bool episode_end = false;
+			reference.step(i, action, rewards[i], episode_end);
+			episode_ends[i] = episode_end;
+		}
+		data = vector_env.step(actions);
+		test::check(
+			torch::equal(data.env_id, torch::arange(kEnvCount, torch::kLong)), "step returns the envs ordered by env id");
+		check_batch(data, reference, rewards, episode_ends, "step");
+	}
+}
+
+void test_async(const Config::AtariEnv& config, int action_count)
+{
+	AtariVectorEnv vector_env(config, kOptions);
+	ReferenceEnvs reference(config);
+	std::vector<float> rewards(kEnvCount, 0.0F);
+	std::vector<bool> episode_ends(kEnvCount, false);
+	test::check(vector_env.batch_size() == kBatchSize, "recv returns batch_size envs");
+
+	vector_env.async_reset();
+	for (int i = 0; i < kEnvCount; ++i) { reference.reset(i); }
+	std::set<int64_t> reset_ids;
+	for (int batch = 0; batch < kEnvCount / kBatchSize; ++batch)
+	{
+		auto data = vector_env.recv();
+		test::check(data.env_id.numel() == kBatchSize, "recv returns a full batch after a reset");
+		check_batch(data, reference, rewards, episode_ends, "async_reset");
+		for (int64_t b = 0; b < data.env_id.numel(); ++b) { reset_ids.insert(data.env_id[b].item<int64_t>()); }
+	}
+	test::check(static_cast<int>(reset_ids.size()) == kEnvCount, "every env is received exactly once after a reset");
+
+	bool threw = false;
+	try
+	{
+		vector_env.recv();
+	}
+	catch (const std::logic_error&)
+	{
+		threw = true;
+	}
+	test::check(threw, "recv throws when fewer envs are pending than the batch size");
+
+	// Keep every env in flight, sending actions only to the envs just received
+	std::mt19937 rng(0);
+	std::uniform_int_distribution<int> dist(0, action_count - 1);
+	auto send = [&](const std::vector<int64_t>& ids) {
+		auto actions = torch::empty({static_cast<int64_t>(ids.size())}, torch::kLong);
+		for (size_t b = 0; b < ids.size(); ++b)
+		{
+			const int id = static_cast<int>(ids[b]);
+			const int action = dist(rng);
+			actions[b] = action;
+			bool episode_end = false;
+			reference.step(id, action, rewards[id], episode_end);
+			episode_ends[id] = episode_end;
+		}
+		vector_env.send(actions, torch::tensor(ids, torch::kLong));
+	};
+	send({0, 1, 2, 3});
+
+	threw = false;
+	try
+	{
+		vector_env.send(torch::zeros({1}, torch::kLong), torch::zeros({1}, torch::kLong));
+	}
+	catch (const std::logic_error&)
+	{
+		threw = true;
+	}
+	test::check(threw, "send throws for an env with a pending step");
+
+	std::set<int64_t> pending = {0, 1, 2, 3};
+	for (int step = 0; step < kSteps; ++step)
+	{
+		auto data = vector_env.recv();
+		test::check(data.env_id.numel() == kBatchSize, "recv returns a full batch");
+		std::vector<int64_t> ids;
+		for (int64_t b = 0; b < data.env_id.numel(); ++b)
+		{
+			const auto id = data.env_id[b].item<int64_t>();
+			auto iter = pending.find(id);
+			test::check(iter != pending.end(), spdlog::fmt_lib::format("recv returns env {} which was sent an action", id));
+			if (iter != pending.end())
+			{
+				pending.erase(iter);
+			}
+			ids.push_back(id);
+		}
+		check_batch(data, reference, rewards, episode_ends, "recv");
+		send(ids);
+		pending.insert(ids.begin(), ids.end());
+	}
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+	const auto rom = test::test_rom(argc, argv);
+	if (rom.empty())
+	{
+		spdlog::warn("No ROM given, skipping");
+		return test::kSkipped;
+	}
+
+	Config::AtariEnv config;
+	config.rom_file = rom.string();
+	config.seed = 0;
+	config.frame_skip = 4;
+	config.frame_stack = 4;
+	config.output_resolution = {84, 84};
+
+	const int action_count = static_cast<int>(Atari(config).get_configuration().action_set.size());
+	test_sync(config, action_count);
+	test_async(config, action_count);
+	return test::result();
+}
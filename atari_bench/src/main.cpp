@@ -0,0 +1,417 @@
+#include "atari_env.h"
+#include "configuration.h"
+#include "preprocessing.h"
+#include "utility.h"
+#include "vector_env.h"
+
+#include <ale_interface.hpp>
+#include <cxxopts.hpp>
+#include <nlohmann/json.hpp>
+#include <spdlog/spdlog.h>
+#include <torch/torch.h>
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <optional>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace atari;
+
+namespace
+{
+
+constexpr int kScreenHeight = 210;
+constexpr int kScreenWidth = 160;
+constexpr auto kMinDuration = std::chrono::milliseconds(200);
+
+struct BenchResult
+{
+	std::string name;
+	// The mean time of a single call
+	double ns_per_call = 0;
+	// The number of items processed by each call, such as emulator frames
+	int items_per_call = 1;
+	std::string item;
+};
+
+// Runs fn repeatedly for at least kMinDuration, returning the mean time per call in nanoseconds
+template <typename Fn>
+double time_per_call(Fn&& fn)
+{
+	// Warm up caches and any lazily selected kernels
+	fn();
+	int64_t calls = 0;
+	const auto start = std::chrono::steady_clock::now();
+	auto elapsed = std::chrono::steady_clock::duration::zero();
+	while (elapsed < kMinDuration)
+	{
+		for (int i = 0; i < 100; ++i) { fn(); }
+		calls += 100;
+		elapsed = std::chrono::steady_clock::now() - start;
+	}
+	return std::chrono::duration<double, std::nano>(elapsed).count() / static_cast<double>(calls);
+}
+
+std::string observation_name(bool grayscale, bool resize, bool use_float)
+{
+	return spdlog::fmt_lib::format(
+		"{}_{}_{}", grayscale ? "grayscale" : "rgb", resize ? "84x84" : "native", use_float ? "float" : "byte");
+}
+
+Config::AtariEnv observation_config(bool grayscale, bool resize, bool use_float)
+{
+	Config::AtariEnv config;
+	config.grayscale = grayscale;
+	config.output_resolution = resize ? std::array<int, 2>{84, 84} : std::array<int, 2>{0, 0};
+	config.use_float = use_float;
+	return config;
+}
+
+// The observation pipeline the specialised pipelines replaced. It converted the screen to float and area interpolated
+// it with torch, then converted it back to bytes before it was copied into the frame stack.
+void torch_preprocess(const Config::AtariEnv& config, const std::vector<uint8_t>& screen, torch::Tensor frame)
+{
+	const int channels = config.grayscale ? 1 : 3;
+	auto raw_frame = torch::from_blob(
+		const_cast<uint8_t*>(screen.data()), {kScreenHeight, kScreenWidth, channels}, torch::kByte);
+	torch::Tensor obs = raw_frame.permute({2, 0, 1});
+	if (config.output_resolution[0] > 0 || config.output_resolution[1] > 0)
+	{
+		int width = config.output_resolution[0] > 0 ? config.output_resolution[0] : kScreenWidth;
+		int height = config.output_resolution[1] > 0 ? config.output_resolution[1] : kScreenHeight;
+		obs = torch::nn::functional::interpolate(
+						obs.to(torch::kFloat).div(255.0F).view({1, channels, kScreenHeight, kScreenWidth}),
+						torch::nn::functional::InterpolateFuncOptions()
+							.size(torch::make_optional<std::vector<int64_t>>({height, width}))
+							.mode(torch::kArea))
+						.view({channels, height, width});
+		if (!config.use_float)
+		{
+			obs = (obs * 255.0F).to(torch::kByte);
+		}
+	}
+	else if (config.use_float)
+	{
+		obs = obs.to(torch::kFloat).div(255.0F);
+	}
+	frame.copy_(obs);
+}
+
+void benchmark_preprocessing(std::vector<BenchResult>& results)
+{
+	std::mt19937 rng(0);
+	for (bool grayscale : {true, false})
+	{
+		for (bool resize : {true, false})
+		{
+			for (bool use_float : {false, true})
+			{
+				auto config = observation_config(grayscale, resize, use_float);
+				FramePreprocessor preprocessor(config, kScreenHeight, kScreenWidth);
+
+				std::vector<uint8_t> screen(preprocessor.screen_size());
+				for (auto& pixel : screen) { pixel = static_cast<uint8_t>(rng()); }
+				auto frame = torch::empty(preprocessor.frame_shape(), use_float ? torch::kFloat : torch::kByte);
+				void* dst = frame.data_ptr();
+
+				const auto name = observation_name(grayscale, resize, use_float);
+				results.push_back(
+					{"preprocess_torch/" + name, time_per_call([&] { torch_preprocess(config, screen, frame); }), 1, "frames"});
+				results.push_back(
+					{"preprocess/" + name, time_per_call([&] { preprocessor.process(screen.data(), dst); }), 1, "frames"});
+			}
+		}
+	}
+}
+
+// Steps the emulator alone with random actions, measuring its raw frame rate
+void benchmark_ale(const std::filesystem::path& rom, std::vector<BenchResult>& results)
+{
+	ale::ALEInterface emulator;
+	emulator.setInt("random_seed", 0);
+	emulator.loadROM(rom);
+	const auto actions = emulator.getMinimalActionSet();
+	std::mt19937 rng(0);
+	std::uniform_int_distribution<size_t> dist(0, actions.size() - 1);
+	results.push_back(
+		{"ale_act",
+		 time_per_call([&] {
+			 emulator.act(actions[dist(rng)]);
+			 if (emulator.game_over())
+			 {
+				 emulator.reset_game();
+			 }
+		 }),
+		 1,
+		 "frames"});
+}
+
+// Steps an environment with random actions, resetting at the end of each episode
+void benchmark_step(const std::string& name, const Config::AtariEnv& config, std::vector<BenchResult>& results)
+{
+	Atari env(config);
+	auto observation = torch::empty(env.observation_shape(), env.observation_dtype());
+	env.reset(0, observation);
+	const int action_count = static_cast<int>(env.get_configuration().action_set.size());
+	std::mt19937 rng(0);
+	std::uniform_int_distribution<int> dist(0, action_count - 1);
+	results.push_back(
+		{name,
+		 time_per_call([&] {
+			 env.step(dist(rng), observation);
+			 if (env.is_episode_end())
+			 {
+				 env.reset(0, observation);
+			 }
+		 }),
+		 std::max(config.frame_skip, 1),
+		 "frames"});
+}
+
+void benchmark_env(const std::filesystem::path& rom, std::vector<BenchResult>& results)
+{
+	// The cost of building each observation, stepping a single frame at a time
+	for (bool grayscale : {true, false})
+	{
+		for (bool resize : {true, false})
+		{
+			for (bool use_float : {false, true})
+			{
+				auto config = observation_config(grayscale, resize, use_float);
+				config.rom_file = rom.string();
+				config.seed = 0;
+				benchmark_step("observation/" + observation_name(grayscale, resize, use_float), config, results);
+			}
+		}
+	}
+
+	for (int frame_skip : {1, 4})
+	{
+		for (int frame_stack : {1, 4, 8})
+		{
+			auto config = observation_config(true, true, false);
+			config.rom_file = rom.string();
+			config.seed = 0;
+			config.frame_skip = frame_skip;
+			config.frame_stack = frame_stack;
+			benchmark_step(
+				spdlog::fmt_lib::format("step/frame_skip_{}_stack_{}", frame_skip, frame_stack), config, results);
+		}
+	}
+
+	for (int noops : {0, 30})
+	{
+		auto config = observation_config(true, true, false);
+		config.rom_file = rom.string();
+		config.seed = 0;
+		config.frame_stack = 4;
+		config.noop_reset_max_frames = noops;
+		Atari env(config);
+		auto observation = torch::empty(env.observation_shape(), env.observation_dtype());
+		results.push_back(
+			{spdlog::fmt_lib::format("reset/noops_{}", noops),
+			 time_per_call([&] { env.reset(0, observation); }),
+			 1,
+			 "resets"});
+	}
+}
+
+// Steps the configured vector environment with random actions, synchronously and when the batch size is smaller than
+// the env count asynchronously, keeping every environment in flight
+void benchmark_vector_env(
+	const Config::AtariEnv& config, const VectorEnvOptions& options, std::vector<BenchResult>& results)
+{
+	AtariVectorEnv env(config, options);
+	const int action_count = static_cast<int>(env.get_configuration().action_set.size());
+	const int frames = std::max(config.frame_skip, 1);
+	std::mt19937 rng(0);
+	std::uniform_int_distribution<int64_t> dist(0, action_count - 1);
+	auto random_actions = [&](int64_t count) {
+		auto actions = torch::empty({count}, torch::kLong);
+		auto* data = actions.data_ptr<int64_t>();
+		for (int64_t i = 0; i < count; ++i) { data[i] = dist(rng); }
+		return actions;
+	};
+
+	env.reset();
+	results.push_back(
+		{spdlog::fmt_lib::format("vector_step/envs_{}", env.size()),
+		 time_per_call([&] { env.step(random_actions(env.size())); }),
+		 env.size() * frames,
+		 "frames"});
+
+	if (env.batch_size() < env.size())
+	{
+		env.async_reset();
+		auto batch = env.recv();
+		results.push_back(
+			{spdlog::fmt_lib::format("vector_async/envs_{}_batch_{}", env.size(), env.batch_size()),
+			 time_per_call([&] {
+				 env.send(random_actions(batch.env_id.numel()), batch.env_id);
+				 batch = env.recv();
+			 }),
+			 env.batch_size() * frames,
+			 "frames"});
+	}
+}
+
+nlohmann::json to_json(const std::vector<BenchResult>& results)
+{
+	nlohmann::json json = nlohmann::json::array();
+	for (const auto& result : results)
+	{
+		const double rate = 1e9 * result.items_per_call / result.ns_per_call;
+		json.push_back({{"name", result.name}, {"ns_per_call", result.ns_per_call}, {result.item + "_per_second", rate}});
+	}
+	return json;
+}
+
+void print_results(const std::vector<BenchResult>& results)
+{
+	spdlog::fmt_lib::print("{:<40} {:>14} {:>20}\n", "benchmark", "time (ns)", "rate");
+	for (const auto& result : results)
+	{
+		const double rate = 1e9 * result.items_per_call / result.ns_per_call;
+		spdlog::fmt_lib::print(
+			"{:<40} {:>14.0f} {:>13.0f} {}/s\n", result.name, result.ns_per_call, rate, result.item);
+	}
+}
+
+// Prints the change in time of each benchmark from the baseline, returning the number which regressed by more than the
+// threshold
+int compare(const std::vector<BenchResult>& results, const nlohmann::json& baseline, double threshold)
+{
+	std::map<std::string, double> baseline_times;
+	for (const auto& entry : baseline) { baseline_times[entry["name"]] = entry["ns_per_call"]; }
+
+	int regressions = 0;
+	spdlog::fmt_lib::print("\n{:<40} {:>14} {:>14} {:>9}\n", "benchmark", "baseline (ns)", "current (ns)", "change");
+	for (const auto& result : results)
+	{
+		auto iter = baseline_times.find(result.name);
+		if (iter == baseline_times.end())
+		{
+			spdlog::fmt_lib::print("{:<40} {:>14} {:>14.0f}\n", result.name, "-", result.ns_per_call);
+			continue;
+		}
+		const double change = 100.0 * (result.ns_per_call - iter->second) / iter->second;
+		const bool regressed = change > threshold;
+		regressions += regressed ? 1 : 0;
+		spdlog::fmt_lib::print(
+			"{:<40} {:>14.0f} {:>14.0f} {:>+8.1f}%{}\n",
+			result.name,
+			iter->second,
+			result.ns_per_call,
+			change,
+			regressed ? " REGRESSION" : "");
+	}
+	return regressions;
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+	cxxopts::Options options("Atari Bench", "Micro-benchmarks of the atari environment hot path");
+	options.add_options()(
+		"r,rom",
+		"The ROM to benchmark the emulator and environment with",
+		cxxopts::value<std::string>()->default_value(""))(
+		"c,config",
+		"Benchmarks the vector environment defined by the env config of this config file. Its ROM is used when no ROM is "
+		"given.",
+		cxxopts::value<std::string>()->default_value(""))(
+		"envs", "The number of environments in the vector environment", cxxopts::value<int>()->default_value("16"))(
+		"batch",
+		"The number of environments each asynchronous receive returns. Values <= 0 only step synchronously.",
+		cxxopts::value<int>()->default_value("8"))(
+		"threads",
+		"The number of threads stepping the vector environment. Values <= 0 use all hardware threads.",
+		cxxopts::value<int>()->default_value("0"))(
+		"o,output", "Saves the results as JSON to this path", cxxopts::value<std::string>()->default_value(""))(
+		"b,baseline",
+		"Compares the results with a JSON baseline saved with --output, failing on regressions",
+		cxxopts::value<std::string>()->default_value(""))(
+		"t,threshold",
+		"The percentage a benchmark can slow down by before it is a regression",
+		cxxopts::value<double>()->default_value("10"))(
+		"h,help", "This printout", cxxopts::value<bool>()->default_value("false"));
+	auto result = options.parse(argc, argv);
+
+	if (result["help"].as<bool>())
+	{
+		options.set_width(100);
+		spdlog::fmt_lib::print("{}", options.help());
+		return 0;
+	}
+
+	spdlog::set_pattern("[%^%l%$] %v");
+	std::filesystem::path rom = result["rom"].as<std::string>();
+	std::filesystem::path config_path = result["config"].as<std::string>();
+	std::filesystem::path output = result["output"].as<std::string>();
+	std::filesystem::path baseline = result["baseline"].as<std::string>();
+
+	std::optional<Config::AtariEnv> vector_config;
+	if (!config_path.empty())
+	{
+		vector_config = utility::load_config(config_path).env;
+		if (rom.empty())
+		{
+			rom = vector_config->rom_file;
+		}
+		vector_config->rom_file = std::filesystem::absolute(rom).string();
+	}
+
+	std::vector<BenchResult> results;
+	benchmark_preprocessing(results);
+	if (rom.empty())
+	{
+		spdlog::warn("No ROM given, so only preprocessing is benchmarked");
+	}
+	else
+	{
+		rom = std::filesystem::absolute(rom);
+		benchmark_ale(rom, results);
+		benchmark_env(rom, results);
+		if (vector_config)
+		{
+			VectorEnvOptions vector_options;
+			vector_options.env_count = result["envs"].as<int>();
+			vector_options.batch_size = result["batch"].as<int>();
+			vector_options.thread_count = result["threads"].as<int>();
+			benchmark_vector_env(*vector_config, vector_options, results);
+		}
+	}
+	print_results(results);
+
+	if (!output.empty())
+	{
+		std::ofstream file(output);
+		file << to_json(results).dump(2);
+		spdlog::info("Results saved to: {}", output.string());
+	}
+
+	if (!baseline.empty())
+	{
+		std::ifstream file(baseline);
+		if (!file.is_open())
+		{
+			spdlog::error("Unable to open the baseline '{}'", baseline.string());
+			return 1;
+		}
+		const int regressions = compare(results, nlohmann::json::parse(file), result["threshold"].as<double>());
+		if (regressions > 0)
+		{
+			spdlog::error("{} benchmarks regressed", regressions);
+			return 1;
+		}
+	}
+
+	return 0;
+}
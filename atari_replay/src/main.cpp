@@ -0,0 +1,139 @@
+#include "atari_env.h"
+#include "configuration.h"
+#include "gif_stream.h"
+#include "recording.h"
+
+#include <cxxopts.hpp>
+#include <spdlog/spdlog.h>
+#include <torch/torch.h>
+
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <vector>
+
+using namespace atari;
+
+namespace
+{
+
+// The environment the recording is replayed with. Only the emulation and observation settings of the recording are
+// kept, as the game is started from the recorded state rather than reset.
+Config::AtariEnv replay_config(const EpisodeRecording& recording, const std::string& rom)
+{
+	auto config = recording.env;
+	if (!rom.empty())
+	{
+		config.rom_file = std::filesystem::absolute(rom).string();
+	}
+	config.reset_ahead = false;
+	config.reset_state_bank_size = 0;
+	config.record_episodes = false;
+	config.clip_reward = false;
+	config.cpu_affinity.clear();
+	return config;
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+	cxxopts::Options options("Atari Replay", "Re-emulates a recorded game to regenerate its frames");
+	options.add_options()("recording", "The recording to replay", cxxopts::value<std::string>())(
+		"r,rom",
+		"The ROM to replay with, when it has moved since the game was recorded",
+		cxxopts::value<std::string>()->default_value(""))(
+		"g,gif", "Saves the visualisations as a GIF to this path", cxxopts::value<std::string>()->default_value(""))(
+		"gif-frame-decimation",
+		"Only every n-th visualisation is added to the GIF",
+		cxxopts::value<int>()->default_value("1"))(
+		"o,observations",
+		"Saves the observations of each step as a tensor to this path",
+		cxxopts::value<std::string>()->default_value(""))(
+		"h,help", "This printout", cxxopts::value<bool>()->default_value("false"));
+	options.parse_positional({"recording"});
+	options.positional_help("<recording>");
+	auto result = options.parse(argc, argv);
+
+	if (result["help"].as<bool>() || result.count("recording") == 0)
+	{
+		options.set_width(100);
+		spdlog::fmt_lib::print("{}", options.help());
+		return result["help"].as<bool>() ? 0 : 1;
+	}
+
+	spdlog::set_pattern("[%^%l%$] %v");
+	const std::filesystem::path recording_path = result["recording"].as<std::string>();
+	const std::filesystem::path gif_path = result["gif"].as<std::string>();
+	const std::filesystem::path observations_path = result["observations"].as<std::string>();
+
+	const auto recording = load_recording(recording_path);
+	const auto config = replay_config(recording, result["rom"].as<std::string>());
+	Atari env(config);
+	auto observation = torch::empty(env.observation_shape(), env.observation_dtype());
+	env.start_replay(recording, observation);
+
+	GifEncoder gif_encoder;
+	std::unique_ptr<GifStream> gif;
+	if (!gif_path.empty())
+	{
+		gif = std::make_unique<GifStream>(gif_encoder, gif_path, 2, result["gif-frame-decimation"].as<int>());
+	}
+	std::vector<torch::Tensor> observations;
+	if (!observations_path.empty())
+	{
+		observations.push_back(observation.clone());
+	}
+
+	const size_t action_count = env.get_configuration().action_set.size();
+	float score = 0;
+	for (size_t step = 0; step < recording.actions.size(); ++step)
+	{
+		const int action = recording.actions[step];
+		if (static_cast<size_t>(action) >= action_count)
+		{
+			spdlog::error("Step {} uses action {}, but the game only has {} actions", step, action, action_count);
+			return 1;
+		}
+		// Lives lost in the recording end the episode without starting a new game, so continue the same way
+		if (env.is_episode_end())
+		{
+			env.reset(0, observation);
+		}
+		score += env.step(action, observation);
+
+		if (gif)
+		{
+			gif->add_frame(env.get_visualisations());
+		}
+		if (!observations_path.empty())
+		{
+			observations.push_back(observation.clone());
+		}
+	}
+
+	if (gif)
+	{
+		gif->close();
+		spdlog::info("GIF of {} frames saved to: {}", gif->frame_count(), gif_path.string());
+	}
+	if (!observations_path.empty())
+	{
+		torch::save(torch::stack(observations), observations_path.string());
+		spdlog::info("Observations of {} steps saved to: {}", observations.size(), observations_path.string());
+	}
+
+	spdlog::info("Replayed {} steps with a score of {}", recording.actions.size(), score);
+	if (score != recording.score)
+	{
+		spdlog::error("The replay diverged from the recording, which scored {}", recording.score);
+		return 1;
+	}
+	// Episodes which reached the step limit are recorded up to the limit, so the game can still be running
+	if (!env.is_episode_end())
+	{
+		spdlog::info("The recording ended before the game was over");
+	}
+
+	return 0;
+}
@@ -0,0 +1,142 @@
+#include "evaluation.h"
+
+#include <nlohmann/json.hpp>
+#include <spdlog/spdlog.h>
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <numeric>
+#include <random>
+
+namespace
+{
+
+constexpr int kBootstrapResamples = 10000;
+
+// The quantile of sorted values, linearly interpolating between the nearest values
+double quantile(const std::vector<double>& sorted, double q)
+{
+	const double position = q * static_cast<double>(sorted.size() - 1);
+	const auto lower = static_cast<size_t>(position);
+	const size_t upper = std::min(lower + 1, sorted.size() - 1);
+	return sorted[lower] + (sorted[upper] - sorted[lower]) * (position - static_cast<double>(lower));
+}
+
+nlohmann::json to_json(const SummaryStatistics& stats)
+{
+	nlohmann::json json;
+	json["mean"] = stats.mean;
+	json["std"] = stats.std;
+	json["min"] = stats.min;
+	json["max"] = stats.max;
+	json["median"] = stats.median;
+	json["q10"] = stats.q10;
+	json["q25"] = stats.q25;
+	json["q75"] = stats.q75;
+	json["q90"] = stats.q90;
+	json["iqr"] = stats.q75 - stats.q25;
+	json["ci95"] = {stats.ci_low, stats.ci_high};
+	return json;
+}
+
+} // namespace
+
+SummaryStatistics summarise(std::vector<double> values, uint32_t seed)
+{
+	SummaryStatistics stats;
+	if (values.empty())
+	{
+		return stats;
+	}
+	const auto count = static_cast<double>(values.size());
+	stats.mean = std::accumulate(values.begin(), values.end(), 0.0) / count;
+	double variance = 0;
+	for (double value : values) { variance += (value - stats.mean) * (value - stats.mean); }
+	stats.std = values.size() > 1 ? std::sqrt(variance / (count - 1)) : 0;
+
+	std::sort(values.begin(), values.end());
+	stats.min = values.front();
+	stats.max = values.back();
+	stats.median = quantile(values, 0.5);
+	stats.q10 = quantile(values, 0.1);
+	stats.q25 = quantile(values, 0.25);
+	stats.q75 = quantile(values, 0.75);
+	stats.q90 = quantile(values, 0.9);
+
+	// The percentile bootstrap of the mean
+	std::mt19937 rng(seed);
+	std::uniform_int_distribution<size_t> dist(0, values.size() - 1);
+	std::vector<double> means(kBootstrapResamples);
+	for (auto& mean : means)
+	{
+		double sum = 0;
+		for (size_t i = 0; i < values.size(); ++i) { sum += values[dist(rng)]; }
+		mean = sum / count;
+	}
+	std::sort(means.begin(), means.end());
+	stats.ci_low = quantile(means, 0.025);
+	stats.ci_high = quantile(means, 0.975);
+
+	return stats;
+}
+
+void save_evaluation(
+	const std::filesystem::path& path,
+	std::vector<EvalEpisode> episodes,
+	int seed,
+	int env_count,
+	int frame_skip,
+	double duration)
+{
+	std::sort(episodes.begin(), episodes.end(), [](const EvalEpisode& a, const EvalEpisode& b) {
+		return a.env != b.env ? a.env < b.env : a.env_episode < b.env_episode;
+	});
+
+	std::vector<double> scores;
+	std::vector<double> lengths;
+	int64_t total_steps = 0;
+	for (const auto& episode : episodes)
+	{
+		scores.push_back(episode.score);
+		lengths.push_back(episode.length);
+		total_steps += episode.length;
+	}
+	const auto score_stats = summarise(scores, static_cast<uint32_t>(seed));
+	const auto length_stats = summarise(lengths, static_cast<uint32_t>(seed));
+	const double steps_per_second = duration > 0 ? static_cast<double>(total_steps) / duration : 0;
+
+	nlohmann::json json;
+	json["episodes"] = episodes.size();
+	json["seed"] = seed;
+	json["env_count"] = env_count;
+	json["score"] = to_json(score_stats);
+	json["length"] = to_json(length_stats);
+	json["duration"] = duration;
+	json["steps_per_second"] = steps_per_second;
+	json["frames_per_second"] = steps_per_second * std::max(frame_skip, 1);
+
+	std::filesystem::create_directories(path);
+	std::ofstream summary_file(path / "eval_summary.json");
+	summary_file << json.dump(2);
+	summary_file.close();
+
+	std::ofstream episodes_file(path / "eval_episodes.csv");
+	episodes_file << "env,env_episode,seed,length,score\n";
+	for (const auto& episode : episodes)
+	{
+		episodes_file << episode.env << "," << episode.env_episode << "," << seed + episode.env << "," << episode.length
+									<< "," << episode.score << "\n";
+	}
+	episodes_file.close();
+
+	spdlog::info(
+		"Score: {:.2f} (95% CI [{:.2f}, {:.2f}]) median: {:.2f} IQR: [{:.2f}, {:.2f}]",
+		score_stats.mean,
+		score_stats.ci_low,
+		score_stats.ci_high,
+		score_stats.median,
+		score_stats.q25,
+		score_stats.q75);
+	spdlog::info("Evaluation summary saved to: {}", path.string());
+}
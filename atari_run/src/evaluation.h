@@ -0,0 +1,55 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <vector>
+
+/// @brief The result of a single evaluation episode
+struct EvalEpisode
+{
+	// The environment which ran the episode
+	int env = 0;
+	// The index of the episode within the environment's episodes
+	int env_episode = 0;
+	int length = 0;
+	float score = 0;
+};
+
+/// @brief Summary statistics of a set of values
+struct SummaryStatistics
+{
+	double mean = 0;
+	double std = 0;
+	double min = 0;
+	double max = 0;
+	double median = 0;
+	double q10 = 0;
+	double q25 = 0;
+	double q75 = 0;
+	double q90 = 0;
+	// The 95% bootstrap confidence interval of the mean
+	double ci_low = 0;
+	double ci_high = 0;
+};
+
+/// @brief Calculates summary statistics, with quantiles linearly interpolated between the nearest values
+/// @param values The values to summarise
+/// @param seed The seed for resampling the confidence interval, so the interval is reproducible
+/// @return The summary statistics
+SummaryStatistics summarise(std::vector<double> values, uint32_t seed);
+
+/// @brief Saves the results of an evaluation, as a JSON summary and a CSV of every episode. Episodes are ordered by
+/// environment so the output doesn't depend on the order the episodes completed in.
+/// @param path The directory to save the summary to
+/// @param episodes The evaluation episodes
+/// @param seed The emulator seed of the first environment
+/// @param env_count The number of environments the episodes were run with
+/// @param frame_skip The number of emulator frames per step
+/// @param duration The wall time of the evaluation in seconds
+void save_evaluation(
+	const std::filesystem::path& path,
+	std::vector<EvalEpisode> episodes,
+	int seed,
+	int env_count,
+	int frame_skip,
+	double duration);
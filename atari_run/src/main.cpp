@@ -1,12 +1,18 @@
 #include "atari_agent/configuration.h"
+#include "atari_agent/profiler.h"
+#include "atari_agent/trace.h"
 #include "atari_agent/utility.h"
 #include "runner.h"
 
 #include <cxxopts.hpp>
 #include <spdlog/spdlog.h>
 
+#include <algorithm>
 #include <cstdio>
 #include <filesystem>
+#include <memory>
+#include <thread>
+#include <vector>
 
 // BUG: https://github.com/pytorch/pytorch/issues/49460
 // This dummy function is a hack to fix an issue with loading pytorch models. It's unnecessary to invoke this function,
@@ -23,9 +29,38 @@ int main(int argc, char** argv)
 	cxxopts::Options options("Atari Run", "Runs an agent, optionally saving a gif");
 	options.add_options()("p,data-path", "The data path to load the model from", cxxopts::value<std::string>())(
 		"g,save-gif", "Saves a gif of the episode(s)", cxxopts::value<bool>()->default_value("false"))(
+		"record",
+		"Saves a recording of each game's actions, which atari_replay can re-emulate to regenerate its frames",
+		cxxopts::value<bool>()->default_value("false"))(
 		"d,debug", "Enable debug logging", cxxopts::value<bool>()->default_value("false"))(
 		"e,env-count", "Number of envs to run", cxxopts::value<int>()->default_value("1"))(
 		"m,max-steps", "Maximum number of steps to run. 0 Implies infinite", cxxopts::value<int>()->default_value("0"))(
+		"n,eval-episodes",
+		"Evaluates exactly this many episodes and saves summary statistics. Uses all hardware threads unless env-count "
+		"is set",
+		cxxopts::value<int>()->default_value("0"))(
+		"s,seed",
+		"The emulator seed of the first env, each following env using the next seed. Defaults to 0 when evaluating, "
+		"otherwise the configured seed is used",
+		cxxopts::value<int>()->default_value("-1"))(
+		"o,eval-path",
+		"The directory to save the evaluation summary to. Defaults to the data path",
+		cxxopts::value<std::string>()->default_value(""))(
+		"profile",
+		"Profiles the throughput and where the time is spent, sweeping the env count",
+		cxxopts::value<bool>()->default_value("false"))(
+		"profile-policy",
+		"The policy to profile: 'model' runs the loaded model, 'random' or 'fixed' step the envs without the agent",
+		cxxopts::value<std::string>()->default_value("model"))(
+		"profile-envs",
+		"Comma separated env counts to profile. Defaults to powers of 2 up to the number of hardware threads",
+		cxxopts::value<std::string>()->default_value(""))(
+		"profile-steps", "The number of steps per env to profile", cxxopts::value<int>()->default_value("1000"))(
+		"trace",
+		"Records a Chrome trace of the env, callback and logging spans to a trace_<time>.json file in the data path",
+		cxxopts::value<bool>()->default_value("false"))(
+		"trace-delay", "The seconds to wait before starting the trace", cxxopts::value<double>()->default_value("0"))(
+		"trace-duration", "The seconds to trace for", cxxopts::value<double>()->default_value("10"))(
 		"h,help", "This printout", cxxopts::value<bool>()->default_value("false"));
 	options.allow_unrecognised_options();
 	auto result = options.parse(argc, argv);
@@ -42,15 +77,75 @@ int main(int argc, char** argv)
 	bool debug = result["debug"].as<bool>();
 	int env_count = result["env-count"].as<int>();
 	int max_steps = result["max-steps"].as<int>();
+	int eval_episodes = result["eval-episodes"].as<int>();
+	int seed = result["seed"].as<int>();
+	std::filesystem::path eval_path = result["eval-path"].as<std::string>();
 
 	spdlog::set_level(debug ? spdlog::level::debug : spdlog::level::info);
 	spdlog::set_pattern("[%^%l%$] %v");
 
 	auto config = atari::utility::load_config(data_path);
+	if (result["record"].as<bool>())
+	{
+		config.env.record_episodes = true;
+	}
+
+	std::unique_ptr<atari::TraceRecorder> trace;
+	if (result["trace"].as<bool>())
+	{
+		trace = std::make_unique<atari::TraceRecorder>(
+			data_path / ("trace_" + atari::utility::get_time() + ".json"),
+			result["trace-delay"].as<double>(),
+			result["trace-duration"].as<double>());
+	}
+
+	if (result["profile"].as<bool>())
+	{
+		const auto policy = atari::parse_profile_policy(result["profile-policy"].as<std::string>());
+		const int steps = result["profile-steps"].as<int>();
+		std::vector<atari::ProfileResult> results;
+		for (int profile_env_count : atari::parse_profile_env_counts(result["profile-envs"].as<std::string>()))
+		{
+			spdlog::info("Profiling {} envs", profile_env_count);
+			if (policy != atari::ProfilePolicy::kModel)
+			{
+				results.push_back(atari::profile_policy(config.env, profile_env_count, steps, policy));
+				continue;
+			}
+			atari::ProfileCallback callback;
+			AtariRunner profile_runner(config, data_path, &callback);
+			callback.set_callback(&profile_runner);
+			// The callback stops each env after the given steps, so the episodes aren't limited
+			results.push_back(atari::profile_agent(
+				callback, profile_env_count, steps, [&]() { profile_runner.run(profile_env_count, 0, false); }));
+		}
+		atari::print_profile(results);
+		return 0;
+	}
 
+	if (eval_episodes > 0)
+	{
+		seed = std::max(seed, 0);
+	}
+	// The environments are created with their seeds, rather than each discarding its first game to reseed on reset
+	if (seed >= 0)
+	{
+		config.env.seed = seed;
+	}
 	AtariRunner runner(config, data_path);
 
-	runner.run(env_count, max_steps, save_gif);
+	if (eval_episodes > 0)
+	{
+		if (result.count("env-count") == 0)
+		{
+			env_count = std::clamp(static_cast<int>(std::thread::hardware_concurrency()), 1, eval_episodes);
+		}
+		runner.evaluate(env_count, eval_episodes, max_steps, seed, eval_path.empty() ? data_path : eval_path);
+	}
+	else
+	{
+		runner.run(env_count, max_steps, save_gif, seed);
+	}
 
 	return 0;
 }
@@ -0,0 +1,100 @@
+#include "progress_reporter.h"
+
+#include <spdlog/fmt/fmt.h>
+
+#include <cstdio>
+#include <iterator>
+#include <string>
+
+#include <unistd.h>
+
+ProgressReporter::ProgressReporter(int env_count, std::chrono::milliseconds interval)
+		: env_count_(env_count)
+		, interval_(interval)
+		, is_terminal_(isatty(fileno(stdout)) != 0)
+		, episode_lengths_(std::make_unique<std::atomic<int>[]>(env_count))
+		, last_report_time_(std::chrono::steady_clock::now())
+{
+	for (int i = 0; i < env_count_; ++i) { episode_lengths_[i] = 0; }
+	thread_ = std::thread(&ProgressReporter::run, this);
+}
+
+ProgressReporter::~ProgressReporter()
+{
+	{
+		std::lock_guard lock(m_stop_);
+		stop_ = true;
+	}
+	cv_stop_.notify_one();
+	thread_.join();
+	report(std::chrono::steady_clock::now());
+	end_line();
+}
+
+void ProgressReporter::step(int env)
+{
+	total_steps_.fetch_add(1, std::memory_order_relaxed);
+	episode_lengths_[env].fetch_add(1, std::memory_order_relaxed);
+}
+
+void ProgressReporter::episode_complete(int env)
+{
+	total_episodes_.fetch_add(1, std::memory_order_relaxed);
+	episode_lengths_[env].store(0, std::memory_order_relaxed);
+}
+
+void ProgressReporter::end_line()
+{
+	std::lock_guard lock(m_print_);
+	if (line_shown_)
+	{
+		fmt::print("\n");
+		std::fflush(stdout);
+		line_shown_ = false;
+	}
+}
+
+void ProgressReporter::run()
+{
+	std::unique_lock lock(m_stop_);
+	auto next_report = std::chrono::steady_clock::now() + interval_;
+	while (!cv_stop_.wait_until(lock, next_report, [this] { return stop_; }))
+	{
+		lock.unlock();
+		report(std::chrono::steady_clock::now());
+		lock.lock();
+		next_report += interval_;
+	}
+}
+
+void ProgressReporter::report(std::chrono::steady_clock::time_point now)
+{
+	const uint64_t steps = total_steps_.load(std::memory_order_relaxed);
+	const uint64_t episodes = total_episodes_.load(std::memory_order_relaxed);
+	const double elapsed = std::chrono::duration<double>(now - last_report_time_).count();
+	const double steps_per_second = elapsed > 0 ? (steps - last_steps_) / elapsed : 0;
+	const double episodes_per_second = elapsed > 0 ? (episodes - last_episodes_) / elapsed : 0;
+	last_report_time_ = now;
+	last_steps_ = steps;
+	last_episodes_ = episodes;
+
+	std::string line = fmt::format(
+		"steps: {} ({:.0f}/s) episodes: {} ({:.2f}/s) lengths:", steps, steps_per_second, episodes, episodes_per_second);
+	for (int i = 0; i < env_count_; ++i)
+	{
+		fmt::format_to(std::back_inserter(line), " {}", episode_lengths_[i].load(std::memory_order_relaxed));
+	}
+
+	std::lock_guard lock(m_print_);
+	if (is_terminal_)
+	{
+		// Clear the rest of the line in case the previous report was longer
+		fmt::print("\r{}\033[K", line);
+		line_shown_ = true;
+	}
+	else
+	{
+		fmt::print("{}\n", line);
+	}
+	std::fflush(stdout);
+}
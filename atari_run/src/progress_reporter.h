@@ -0,0 +1,60 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+/// @brief Prints the progress of a run at a fixed interval from its own thread. Env threads only update atomic
+/// counters, keeping console output out of the stepping path. When stdout is a terminal the progress is shown on a single line
+/// which is overwritten, otherwise a new line is printed for each report.
+class ProgressReporter
+{
+public:
+	/// @brief Starts the reporting thread
+	/// @param env_count The number of environments being run
+	/// @param interval The time between reports
+	ProgressReporter(int env_count, std::chrono::milliseconds interval);
+
+	/// @brief Prints a final report and stops the reporting thread
+	~ProgressReporter();
+
+	/// @brief Records a step of an environment. Safe to call from any thread.
+	/// @param env The environment which stepped
+	void step(int env);
+
+	/// @brief Records the completion of an environment's episode, resetting its length. Safe to call from any thread.
+	/// @param env The environment which completed an episode
+	void episode_complete(int env);
+
+	/// @brief Ends the progress line when one is being shown on the terminal, so other output starts on its own line
+	void end_line();
+
+private:
+	void run();
+	void report(std::chrono::steady_clock::time_point now);
+
+	const int env_count_;
+	const std::chrono::milliseconds interval_;
+	const bool is_terminal_;
+
+	std::atomic<uint64_t> total_steps_ = 0;
+	std::atomic<uint64_t> total_episodes_ = 0;
+	std::unique_ptr<std::atomic<int>[]> episode_lengths_;
+
+	// Only used by the reporting thread, to calculate rates since the previous report
+	std::chrono::steady_clock::time_point last_report_time_;
+	uint64_t last_steps_ = 0;
+	uint64_t last_episodes_ = 0;
+
+	std::mutex m_print_;
+	bool line_shown_ = false;
+
+	std::mutex m_stop_;
+	std::condition_variable cv_stop_;
+	bool stop_ = false;
+	std::thread thread_;
+};
@@ -1,70 +1,94 @@
 #include "runner.h"
 
-#include <drla/auxiliary/tensor_media.h>
+#include "atari_agent/recording.h"
+#include "atari_agent/trace.h"
+
 #include <spdlog/fmt/chrono.h>
 #include <spdlog/fmt/fmt.h>
 #include <spdlog/spdlog.h>
 
+#include <algorithm>
+#include <chrono>
 #include <filesystem>
+#include <memory>
 #include <string>
 
 using namespace atari;
 using namespace drla;
 
-AtariRunner::AtariRunner(atari::ConfigData config, const std::filesystem::path& path)
-		: config_(config), data_path_(path), atari_agent_(std::move(config), this, path)
+namespace
+{
+
+constexpr std::chrono::seconds kProgressInterval{1};
+
+} // namespace
+
+AtariRunner::AtariRunner(
+	atari::ConfigData config, const std::filesystem::path& path, drla::AgentCallbackInterface* callback)
+		: config_(config), data_path_(path), atari_agent_(std::move(config), callback != nullptr ? callback : this, path)
 {
 }
 
-void AtariRunner::run(int env_count, int max_steps, bool save_gif)
+void AtariRunner::run(int env_count, int max_steps, bool save_gif, int seed)
 {
 	current_episodes_.resize(env_count);
+	env_episode_counts_.assign(env_count, 0);
+	save_gif_ = save_gif;
 
 	spdlog::info("Running {} environments\n", env_count);
 
+	progress_ = std::make_unique<ProgressReporter>(env_count, kProgressInterval);
 	{
 		drla::RunOptions options;
 		options.enable_visualisations = save_gif;
 		options.max_steps = max_steps;
 
-		atari_agent_.run(env_count, options);
+		atari_agent_.run(env_count, options, seed);
 	}
+	progress_.reset();
 
-	fmt::print("\n");
 	spdlog::info("Complete!", env_count);
 
-	for (auto& episode_result : episode_results_)
+	// Episodes which didn't finish are not saved
+	for (auto& episode_result : current_episodes_)
 	{
-		if (config_.env.end_episode_on_life_loss)
+		if (episode_result.gif)
 		{
-			for (size_t i = 0; i < episode_result.life_length.size(); i++)
-			{
-				spdlog::info("Life length: {}", episode_result.life_length[i]);
-				spdlog::info("Life Reward: {}", episode_result.life_reward[i]);
-			}
-		}
-		else
-		{
-			const float episode_reward = episode_result.reward[0].item<float>();
-			spdlog::info("Episode length: {}", episode_result.length);
-			spdlog::info("Episode Reward: {}", episode_reward);
+			std::shared_ptr<GifStream> gif = std::move(episode_result.gif);
+			gif_encoder_.submit([gif, gif_path = episode_result.gif_path]() {
+				gif->close();
+				std::filesystem::remove(gif_path);
+			});
 		}
+	}
+
+	if (completed_episode_count_ > 0)
+	{
+		spdlog::info("Episodes: {}", completed_episode_count_);
+		spdlog::info("Mean episode length: {:.1f}", static_cast<double>(total_episode_length_) / completed_episode_count_);
+		spdlog::info("Mean score: {:.2f}", total_score_ / completed_episode_count_);
+		spdlog::info("Score range: [{}, {}]", min_score_, max_score_);
+	}
+}
 
-		spdlog::info("Score: {}", episode_result.score.item<float>());
+void AtariRunner::evaluate(
+	int env_count, int episodes, int max_steps, int seed, const std::filesystem::path& output_path)
+{
+	eval_episode_budget_ = episodes;
+	eval_results_.reserve(episodes);
 
-		if (save_gif && episode_result.step_data.size() > 2)
-		{
-			auto gif_path = data_path_ / fmt::format(
-																		 "capture_{:%Y-%m-%d}_score_{}_ep{}.gif",
-																		 fmt::localtime(std::time(nullptr)),
-																		 episode_result.score.item<float>(),
-																		 episode_result.id);
-			std::vector<torch::Tensor> images;
-			images.reserve(episode_result.step_data.size());
-			for (auto& step_data : episode_result.step_data) { images.push_back(step_data.visualisation.front()); }
-			save_gif_animation(gif_path, images, 2);
-		}
+	spdlog::info("Evaluating {} episodes with seed {}", episodes, seed);
+	const auto start = std::chrono::steady_clock::now();
+	run(env_count, max_steps, false, seed);
+	const double duration = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	if (static_cast<int>(eval_results_.size()) < episodes)
+	{
+		spdlog::warn("Only {} of {} episodes completed", eval_results_.size(), episodes);
 	}
+	save_evaluation(output_path, std::move(eval_results_), seed, env_count, config_.env.frame_skip, duration);
+	eval_results_.clear();
+	eval_episode_budget_ = 0;
 }
 
 void AtariRunner::train_init(const drla::InitData& data)
@@ -73,14 +97,21 @@ void AtariRunner::train_init(const drla::InitData& data)
 
 drla::AgentResetConfig AtariRunner::env_reset(const drla::StepData& data)
 {
+	ATARI_TRACE_SCOPE("env_reset", "callback");
 	std::lock_guard lock(m_step_);
 	EpisodeResult& episode_result = current_episodes_[data.env];
 
 	if (episode_result.length == 0 || std::any_cast<const EnvState&>(data.env_data.state.env_state).lives == 0)
 	{
+		if (eval_episode_budget_ > 0 && env_episode_counts_[data.env] >= episode_quota(data.env))
+		{
+			// Stop the env once it has run its share of the episodes
+			return {true};
+		}
 		// Clear the previous episode result for the env of this step data
 		episode_result = {};
 		episode_result.id = total_game_count_++;
+		episode_result.env_episode = env_episode_counts_[data.env]++;
 		episode_result.reward = torch::zeros(data.reward.sizes());
 		episode_result.score = torch::zeros(data.env_data.reward.sizes());
 	}
@@ -90,16 +121,26 @@ drla::AgentResetConfig AtariRunner::env_reset(const drla::StepData& data)
 
 bool AtariRunner::env_step(const drla::StepData& data)
 {
-	std::lock_guard lock(m_step_);
-	fmt::print("\rstep: ");
-	for (auto& eps : current_episodes_) { fmt::print("{} ", eps.length); }
+	ATARI_TRACE_SCOPE("env_step", "callback");
+	progress_->step(data.env);
 
+	std::lock_guard lock(m_step_);
 	EpisodeResult& episode_result = current_episodes_[data.env];
 
 	episode_result.length++;
 	episode_result.reward += data.reward;
 	episode_result.score += data.env_data.reward;
-	episode_result.step_data.push_back(data);
+	if (save_gif_ && !data.visualisation.empty())
+	{
+		if (!episode_result.gif)
+		{
+			// The score is only known at the end of the episode, so the gif is renamed once complete
+			episode_result.gif_path = data_path_ / fmt::format("capture_ep{}.gif.partial", episode_result.id);
+			episode_result.gif =
+				std::make_unique<GifStream>(gif_encoder_, episode_result.gif_path, 2, config_.gif_frame_decimation);
+		}
+		episode_result.gif->add_frame(data.visualisation);
+	}
 
 	if (data.env_data.state.episode_end)
 	{
@@ -126,14 +167,98 @@ bool AtariRunner::env_step(const drla::StepData& data)
 		if (game_over)
 		{
 			episode_result.env = data.env;
-			episode_results_.push_back(std::move(episode_result));
-			return true;
+			if (episode_result.gif)
+			{
+				finish_gif(episode_result);
+			}
+			if (const auto& recording = std::any_cast<const EnvState&>(data.env_data.state.env_state).recording)
+			{
+				save_recording(
+					data_path_ /
+						fmt::format("recording_ep{}_score_{}.rec", episode_result.id, episode_result.score.item<float>()),
+					*recording);
+			}
+			progress_->episode_complete(data.env);
+			log_episode(episode_result);
+			if (eval_episode_budget_ > 0)
+			{
+				eval_results_.push_back(
+					{data.env, episode_result.env_episode, episode_result.length, episode_result.score.item<float>()});
+			}
+			// Clearing the length makes env_reset start a new result for this env
+			episode_result = {};
+			// When evaluating the env continues until it has run its share of the episodes
+			return eval_episode_budget_ <= 0 || env_episode_counts_[data.env] >= episode_quota(data.env);
 		}
 	}
 
 	return false;
 }
 
+void AtariRunner::finish_gif(EpisodeResult& episode_result)
+{
+	auto gif_path = data_path_ / fmt::format(
+																 "capture_{:%Y-%m-%d}_score_{}_ep{}.gif",
+																 fmt::localtime(std::time(nullptr)),
+																 episode_result.score.item<float>(),
+																 episode_result.id);
+	// Queued after the gif's frames, so closing it on the encoder doesn't wait
+	std::shared_ptr<GifStream> gif = std::move(episode_result.gif);
+	gif_encoder_.submit([gif, partial_path = episode_result.gif_path, gif_path]() {
+		ATARI_TRACE_SCOPE("finish_gif", "gif");
+		gif->close();
+		if (gif->frame_count() <= 2)
+		{
+			std::filesystem::remove(partial_path);
+		}
+		else
+		{
+			std::filesystem::rename(partial_path, gif_path);
+		}
+	});
+}
+
+void AtariRunner::log_episode(const EpisodeResult& episode_result)
+{
+	const float score = episode_result.score.item<float>();
+	if (completed_episode_count_ == 0)
+	{
+		min_score_ = score;
+		max_score_ = score;
+	}
+	else
+	{
+		min_score_ = std::min(min_score_, score);
+		max_score_ = std::max(max_score_, score);
+	}
+	++completed_episode_count_;
+	total_episode_length_ += episode_result.length;
+	total_score_ += score;
+
+	progress_->end_line();
+	if (config_.env.end_episode_on_life_loss)
+	{
+		for (size_t i = 0; i < episode_result.life_length.size(); i++)
+		{
+			spdlog::info("Life length: {}", episode_result.life_length[i]);
+			spdlog::info("Life Reward: {}", episode_result.life_reward[i]);
+		}
+	}
+	else
+	{
+		const float episode_reward = episode_result.reward[0].item<float>();
+		spdlog::info("Episode length: {}", episode_result.length);
+		spdlog::info("Episode Reward: {}", episode_reward);
+	}
+	spdlog::info("Score: {}", score);
+}
+
+int AtariRunner::episode_quota(int env) const
+{
+	const int env_count = static_cast<int>(current_episodes_.size());
+	return eval_episode_budget_ / env_count + (env < eval_episode_budget_ % env_count ? 1 : 0);
+}
+
 void AtariRunner::train_update(const drla::TrainUpdateData& timestep_data)
 {
 }
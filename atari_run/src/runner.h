@@ -2,32 +2,58 @@
 
 #include "atari_agent.h"
 #include "atari_agent/configuration.h"
+#include "atari_agent/gif_stream.h"
+#include "evaluation.h"
+#include "progress_reporter.h"
 
 #include <drla/callback.h>
 
-#include <deque>
 #include <filesystem>
+#include <memory>
 #include <vector>
 
 struct EpisodeResult
 {
 	int id = 0;
 	int env = 0;
+	// The index of the episode within the env's episodes
+	int env_episode = 0;
 	int length = 0;
 	std::vector<int> life_length;
 	std::vector<float> life_reward;
 
 	torch::Tensor reward;
 	torch::Tensor score;
-	std::deque<drla::StepData> step_data;
+	// Encodes the episode's visualisations as they are captured, when saving gifs
+	std::unique_ptr<atari::GifStream> gif;
+	std::filesystem::path gif_path;
 };
 
 class AtariRunner : public drla::AgentCallbackInterface
 {
 public:
-	AtariRunner(atari::ConfigData config, const std::filesystem::path& path);
+	/// @param config The configuration of the agent and environment
+	/// @param path The data path to load the model from
+	/// @param callback The callback the agent uses, which must forward to the runner. Null uses the runner directly.
+	AtariRunner(
+		atari::ConfigData config, const std::filesystem::path& path, drla::AgentCallbackInterface* callback = nullptr);
 
-	void run(int env_count, int max_steps, bool save_gif);
+	/// @brief Runs the agent, logging a summary of each episode as it completes
+	/// @param env_count The number of environments to run
+	/// @param max_steps The maximum number of steps to run. 0 implies no limit.
+	/// @param save_gif Saves a gif of each episode
+	/// @param seed The emulator seed of the first environment, each following environment using the next seed. Negative
+	/// values keep the seeds from the configuration.
+	void run(int env_count, int max_steps, bool save_gif, int seed = -1);
+
+	/// @brief Runs exactly the given number of episodes and saves summary statistics of the results. The episodes are
+	/// divided evenly between the environments, so the results are reproducible for a given seed and env count.
+	/// @param env_count The number of environments to run
+	/// @param episodes The number of episodes to evaluate
+	/// @param max_steps The maximum number of steps per episode. 0 implies no limit.
+	/// @param seed The emulator seed of the first environment, each following environment using the next seed
+	/// @param output_path The directory to save the evaluation summary to
+	void evaluate(int env_count, int episodes, int max_steps, int seed, const std::filesystem::path& output_path);
 
 private:
 	void train_init(const drla::InitData& data) override;
@@ -38,13 +64,36 @@ private:
 
 	void save(int steps, const std::filesystem::path& path) override;
 
+	void finish_gif(EpisodeResult& episode_result);
+	void log_episode(const EpisodeResult& episode_result);
+	int episode_quota(int env) const;
+
 	atari::ConfigData config_;
 	std::filesystem::path data_path_;
+	bool save_gif_ = false;
 
 	atari::AtariAgent atari_agent_;
 
+	std::unique_ptr<ProgressReporter> progress_;
+
+	// Encodes the gifs of all episodes, and closes them once complete so the env threads don't wait for the encoding.
+	// Declared before the episodes so it outlives their gifs.
+	atari::GifEncoder gif_encoder_;
+
 	std::mutex m_step_;
 	std::vector<EpisodeResult> current_episodes_;
-	std::vector<EpisodeResult> episode_results_;
 	int total_game_count_ = 0;
+
+	// Aggregates over all completed episodes, so memory use doesn't grow with the length of the run
+	int completed_episode_count_ = 0;
+	int64_t total_episode_length_ = 0;
+	double total_score_ = 0;
+	float min_score_ = 0;
+	float max_score_ = 0;
+
+	// The number of episodes to evaluate, 0 when not evaluating
+	int eval_episode_budget_ = 0;
+	// The number of episodes each env has started
+	std::vector<int> env_episode_counts_;
+	std::vector<EvalEpisode> eval_results_;
 };
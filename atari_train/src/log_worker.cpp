@@ -0,0 +1,107 @@
+#include "log_worker.h"
+
+#include <spdlog/spdlog.h>
+
+#include <algorithm>
+#include <exception>
+
+using namespace atari;
+
+LogWorker::LogWorker(int capacity, LogBackpressure backpressure, int sample_interval)
+		: capacity_(std::max(capacity, 1))
+		, backpressure_(backpressure)
+		, sample_interval_(std::max(sample_interval, 1))
+		, thread_(&LogWorker::run, this)
+{
+}
+
+LogWorker::~LogWorker()
+{
+	{
+		std::lock_guard lock(m_tasks_);
+		stop_ = true;
+	}
+	cv_tasks_.notify_one();
+	thread_.join();
+}
+
+void LogWorker::submit(std::function<void()> task)
+{
+	{
+		std::unique_lock lock(m_tasks_);
+		cv_space_.wait(lock, [this] { return tasks_.size() < capacity_; });
+		tasks_.push_back(std::move(task));
+	}
+	cv_tasks_.notify_one();
+}
+
+bool LogWorker::submit_heavy(std::function<void()> task)
+{
+	{
+		std::unique_lock lock(m_tasks_);
+		bool drop = false;
+		switch (backpressure_)
+		{
+			case LogBackpressure::kBlock: break;
+			case LogBackpressure::kDrop: drop = tasks_.size() >= capacity_; break;
+			case LogBackpressure::kSample:
+			{
+				// Once the queue is half full only every n-th heavy task is kept, dropping all of them when full
+				if (tasks_.size() >= capacity_)
+				{
+					drop = true;
+				}
+				else if (tasks_.size() >= capacity_ / 2)
+				{
+					drop = (sample_count_++ % sample_interval_) != 0;
+				}
+				else
+				{
+					sample_count_ = 0;
+				}
+				break;
+			}
+		}
+		if (drop)
+		{
+			++dropped_;
+			return false;
+		}
+		cv_space_.wait(lock, [this] { return tasks_.size() < capacity_; });
+		tasks_.push_back(std::move(task));
+	}
+	cv_tasks_.notify_one();
+	return true;
+}
+
+int LogWorker::dropped() const
+{
+	return dropped_.load();
+}
+
+void LogWorker::run()
+{
+	while (true)
+	{
+		std::function<void()> task;
+		{
+			std::unique_lock lock(m_tasks_);
+			cv_tasks_.wait(lock, [this] { return stop_ || !tasks_.empty(); });
+			if (tasks_.empty())
+			{
+				return;
+			}
+			task = std::move(tasks_.front());
+			tasks_.pop_front();
+		}
+		cv_space_.notify_one();
+		try
+		{
+			task();
+		}
+		catch (const std::exception& e)
+		{
+			spdlog::error("Logging failed: {}", e.what());
+		}
+	}
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include "atari_agent/configuration.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+/// @brief Runs logging tasks in order on a background thread, so the training thread only queues them. The queue is
+/// bounded, with the backpressure policy deciding what happens to heavy tasks when the worker falls behind.
+class LogWorker
+{
+public:
+	/// @brief Starts the worker thread
+	/// @param capacity The maximum number of queued tasks
+	/// @param backpressure The policy for heavy tasks when the queue is backlogged
+	/// @param sample_interval With the sample policy, the interval of heavy tasks to keep while backlogged
+	LogWorker(int capacity, atari::LogBackpressure backpressure, int sample_interval);
+
+	/// @brief Completes all queued tasks, then stops the worker thread
+	~LogWorker();
+
+	/// @brief Queues a task which is always run, blocking while the queue is full. Used for cheap work such as scalars,
+	/// which must not be lost.
+	/// @param task The task to run
+	void submit(std::function<void()> task);
+
+	/// @brief Queues a heavy task, such as encoding images or writing files, subject to the backpressure policy
+	/// @param task The task to run
+	/// @return True if the task was queued, false if it was dropped
+	bool submit_heavy(std::function<void()> task);
+
+	/// @brief The number of heavy tasks dropped so far
+	int dropped() const;
+
+private:
+	void run();
+
+	const size_t capacity_;
+	const atari::LogBackpressure backpressure_;
+	const int sample_interval_;
+
+	std::mutex m_tasks_;
+	std::condition_variable cv_tasks_;
+	std::condition_variable cv_space_;
+	std::deque<std::function<void()>> tasks_;
+	bool stop_ = false;
+	int sample_count_ = 0;
+	std::atomic<int> dropped_ = 0;
+
+	std::thread thread_;
+};
@@ -1,19 +1,44 @@
 #include "logger.h"
 
+#include "atari_agent/statistics.h"
+#include "atari_agent/trace.h"
 #include "atari_agent/utility.h"
 
 #include <nlohmann/json.hpp>
 #include <spdlog/spdlog.h>
 
+#include <algorithm>
 #include <filesystem>
 #include <fstream>
 #include <string>
+#include <vector>
 
 using namespace atari;
 using namespace drla;
 
+namespace
+{
+
+// The RGB image of a visualisation, expanding palette indexed visualisations through their palette
+torch::Tensor visualisation_image(const drla::Observations& visualisation)
+{
+	if (visualisation.size() < 2)
+	{
+		return visualisation.front().cpu();
+	}
+	const auto& indices = visualisation[0];
+	const auto& palette = visualisation[1];
+	return palette.index_select(0, indices.flatten().to(torch::kLong)).view({indices.size(0), indices.size(1), 3}).cpu();
+}
+
+} // namespace
+
 AtariTrainingLogger::AtariTrainingLogger(atari::ConfigData config, const std::filesystem::path& path, bool resume)
-		: config_(config), metrics_logger_(path, resume)
+		: config_(config)
+		, gif_path_(path / "gifs")
+		, recording_path_(path / "recordings")
+		, metrics_logger_(path, resume)
+		, log_worker_(config_.log_queue_size, config_.log_backpressure, config_.log_sample_interval)
 {
 	std::filesystem::path buffer_save_path = std::visit(
 		[](auto& agent) {
@@ -63,12 +88,13 @@ void AtariTrainingLogger::train_init(const drla::InitData& data)
 	current_episodes_.resize(data.env_output.size());
 	for (auto& ep : current_episodes_) { ep.id = total_game_count_++; }
 
-	metrics_logger_.init(total_timesteps);
+	log_worker_.submit([this, total_timesteps]() { metrics_logger_.init(total_timesteps); });
 }
 
 drla::AgentResetConfig AtariTrainingLogger::env_reset(const drla::StepData& data)
 {
-	std::lock_guard lock(m_step_);
+	ATARI_PERF_SCOPE(PerfStage::kEnvResetCallback);
+	ATARI_TRACE_SCOPE("env_reset", "callback");
 	EpisodeResult& episode_result = current_episodes_.at(data.env);
 	episode_result.eval_episode = data.eval_mode;
 	episode_result.name = data.name;
@@ -79,10 +105,11 @@ drla::AgentResetConfig AtariTrainingLogger::env_reset(const drla::StepData& data
 
 bool AtariTrainingLogger::env_step(const drla::StepData& data)
 {
-	std::lock_guard lock(m_step_);
+	ATARI_PERF_SCOPE(PerfStage::kEnvStepCallback);
+	ATARI_TRACE_SCOPE("env_step", "callback");
 	EpisodeResult& episode_result = current_episodes_.at(data.env);
 
-	if (episode_result.step_data.empty())
+	if (!episode_result.reward.defined())
 	{
 		episode_result.reward = data.reward;
 		episode_result.score = data.env_data.reward;
@@ -92,7 +119,29 @@ bool AtariTrainingLogger::env_step(const drla::StepData& data)
 		episode_result.reward += data.reward;
 		episode_result.score += data.env_data.reward;
 	}
-	episode_result.step_data.push_back(data);
+	if ((episode_result.render_gif || episode_result.eval_episode) && !data.visualisation.empty())
+	{
+		if (config_.stream_gifs)
+		{
+			if (!episode_result.gif)
+			{
+				std::filesystem::create_directory(gif_path_);
+				auto name = fmt::format("{}_ep{}.gif", episode_result.eval_episode ? "eval" : "train", episode_result.id);
+				episode_result.gif =
+					std::make_shared<GifStream>(gif_encoder_, gif_path_ / name, 2, config_.gif_frame_decimation);
+			}
+			episode_result.gif->add_frame(data.visualisation);
+		}
+		else if ((episode_result.visualisation_count++ % std::max(config_.gif_frame_decimation, 1)) == 0)
+		{
+			episode_result.gif_frames.push_back(data.visualisation);
+		}
+	}
+	// The first observation is only an image when pixels are observed
+	if (episode_result.render_final && config_.env.observation_mode != Config::ObservationMode::kRAM)
+	{
+		episode_result.final_observation = data.env_data.observation.front();
+	}
 
 	if (data.env_data.state.episode_end)
 	{
@@ -115,23 +164,18 @@ bool AtariTrainingLogger::env_step(const drla::StepData& data)
 		if (game_over)
 		{
 			episode_result.env = data.env;
-			episode_results_.push_back(std::move(episode_result));
+			episode_result.recording = std::any_cast<const EnvState&>(data.env_data.state.env_state).recording;
+			completed_episodes_.push(std::move(episode_result));
 			episode_result = {};
 			episode_result.id = total_game_count_++;
-			episode_result.render_final = total_episode_count_ == next_final_capture_ep_;
-			episode_result.render_gif = total_episode_count_ == next_gif_capture_ep_;
-			if (!data.eval_mode)
-			{
-				++total_episode_count_;
-			}
+			// Each training episode takes a unique number, so only one env captures the requested episode
+			const int episode_number = data.eval_mode ? total_episode_count_.load() : total_episode_count_++;
+			episode_result.render_final = episode_number == next_final_capture_ep_;
+			episode_result.render_gif = episode_number == next_gif_capture_ep_;
 		}
 	}
 	else
 	{
-		if (!episode_result.render_gif && !episode_result.eval_episode && episode_result.step_data.size() > 1)
-		{
-			episode_result.step_data.pop_front();
-		}
 		episode_result.length++;
 	}
 
@@ -140,50 +184,55 @@ bool AtariTrainingLogger::env_step(const drla::StepData& data)
 
 void AtariTrainingLogger::train_update(const drla::TrainUpdateData& timestep_data)
 {
-	metrics_logger_.update(timestep_data);
+	ATARI_PERF_SCOPE(PerfStage::kTrainUpdateCallback);
+	ATARI_TRACE_SCOPE("train_update", "callback");
+	log_worker_.submit([this, timestep_data]() {
+		ATARI_TRACE_SCOPE("metrics_update", "metrics");
+		metrics_logger_.update(timestep_data);
+	});
 
-	m_step_.lock();
-	for (auto& episode_result : episode_results_)
+	EpisodeResult completed_episode;
+	while (completed_episodes_.pop(completed_episode))
 	{
-		if (episode_result.eval_episode)
+		auto episode = std::make_shared<const EpisodeResult>(std::move(completed_episode));
+		log_worker_.submit([this, episode]() { log_episode_scalars(*episode); });
+
+		// Images and file writes are the heavy work which the backpressure policy applies to
+		if (episode->render_final && !episode->eval_episode && episode->final_observation.defined())
 		{
-			metrics_logger_.add_scalar("environment", "reward_eval", episode_result.reward[0].item<float>());
+			log_worker_.submit_heavy([this, episode]() {
+				ATARI_TRACE_SCOPE("final_frame", "metrics");
+				metrics_logger_.add_image("observations", "final_frame", episode->final_observation);
+			});
 		}
-		else
+		if (!episode->gif_frames.empty())
 		{
-			metrics_logger_.add_scalar("environment", "episode_length", double(episode_result.length));
-
-			if (config_.env.end_episode_on_life_loss)
-			{
-				for (size_t i = 0; i < episode_result.life_length.size(); i++)
-				{
-					metrics_logger_.add_scalar("environment", "life_length", static_cast<float>(episode_result.life_length[i]));
-					metrics_logger_.add_scalar("environment", "reward", episode_result.life_reward[i]);
-				}
-			}
-			else
-			{
-				metrics_logger_.add_scalar("environment", "reward", episode_result.reward[0].item<float>());
-			}
-
-			metrics_logger_.add_scalar("environment", "score", episode_result.score.item<float>());
-
-			if (episode_result.render_final)
-			{
-				metrics_logger_.add_image(
-					"observations", "final_frame", episode_result.step_data.back().env_data.observation.front());
-			}
+			log_worker_.submit_heavy([this, episode]() {
+				ATARI_TRACE_SCOPE("episode_animation", "metrics");
+				std::vector<torch::Tensor> images;
+				images.reserve(episode->gif_frames.size());
+				for (const auto& frame : episode->gif_frames) { images.push_back(visualisation_image(frame)); }
+				metrics_logger_.add_animation("episode", episode->eval_episode ? "eval" : "train", images);
+			});
 		}
-		if (episode_result.render_gif || episode_result.eval_episode)
+		// Closing a streamed gif waits for its frames to be encoded, so it's closed here rather than on the env's thread
+		if (episode->gif)
 		{
-			std::vector<torch::Tensor> images;
-			images.reserve(episode_result.step_data.size());
-			for (auto& step_data : episode_result.step_data) { images.push_back(step_data.visualisation.front().cpu()); }
-			metrics_logger_.add_animation("episode", episode_result.eval_episode ? "eval" : "train", images);
+			log_worker_.submit([episode]() { episode->gif->close(); });
 		}
-		if (!episode_result.name.empty() && !buffer_path_.empty())
+		if (!episode->name.empty() && !buffer_path_.empty())
 		{
-			save_episode_metrics(episode_result);
+			log_worker_.submit_heavy([this, episode]() { save_episode_metrics(*episode); });
+		}
+		// Recordings are small and are the archive of each game, so are never dropped
+		if (episode->recording)
+		{
+			log_worker_.submit([this, episode]() {
+				ATARI_TRACE_SCOPE("save_recording", "metrics");
+				std::filesystem::create_directory(recording_path_);
+				auto name = fmt::format("{}_ep{}.rec", episode->eval_episode ? "eval" : "train", episode->id);
+				save_recording(recording_path_ / name, *episode->recording);
+			});
 		}
 	}
 
@@ -196,16 +245,87 @@ void AtariTrainingLogger::train_update(const drla::TrainUpdateData& timestep_dat
 		next_final_capture_ep_ = total_episode_count_ + 1;
 	}
 
-	episode_results_.clear();
-	m_step_.unlock();
+	const double reset_ahead_blocked = static_cast<double>(env_statistics().reset_ahead_blocked.load());
+	const double dropped_log_tasks = static_cast<double>(log_worker_.dropped());
+	log_worker_.submit([this, reset_ahead_blocked, dropped_log_tasks]() {
+		if (config_.env.reset_ahead)
+		{
+			// The total number of resets which stalled an environment waiting for its next game to start
+			metrics_logger_.add_scalar("environment", "reset_ahead_blocked", reset_ahead_blocked);
+		}
+		if (config_.log_backpressure != LogBackpressure::kBlock)
+		{
+			metrics_logger_.add_scalar("logging", "dropped_tasks", dropped_log_tasks);
+		}
+	});
+
+	if constexpr (kPerfEnabled)
+	{
+		// The counters only increase, so the interval since the last update is logged
+		const auto perf = perf_totals();
+		PerfCounters interval;
+		for (size_t i = 0; i < perf.size(); ++i)
+		{
+			interval[i] = {perf[i].calls - last_perf_[i].calls, perf[i].ns - last_perf_[i].ns};
+		}
+		last_perf_ = perf;
+		log_worker_.submit([this, interval]() { log_perf(interval); });
+	}
 
 	if (timestep_data.timestep >= 0 && ((timestep_data.timestep % config_.metric_image_log_period) == 0))
 	{
-		const auto& train_data = timestep_data.metrics.get_data();
-		for (auto [name, data] : train_data) { metrics_logger_.add_animation("metrics", name, data.front()); }
+		log_worker_.submit_heavy([this, timestep_data]() {
+			ATARI_TRACE_SCOPE("metric_animations", "metrics");
+			const auto& train_data = timestep_data.metrics.get_data();
+			for (auto [name, data] : train_data) { metrics_logger_.add_animation("metrics", name, data.front()); }
+		});
+	}
+
+	const int episode_count = total_episode_count_.load();
+	log_worker_.submit([this, timestep_data, episode_count]() { metrics_logger_.print(timestep_data, episode_count); });
+}
+
+void AtariTrainingLogger::log_episode_scalars(const EpisodeResult& episode_result)
+{
+	if (episode_result.eval_episode)
+	{
+		metrics_logger_.add_scalar("environment", "reward_eval", episode_result.reward[0].item<float>());
+		return;
 	}
 
-	metrics_logger_.print(timestep_data, total_episode_count_);
+	metrics_logger_.add_scalar("environment", "episode_length", double(episode_result.length));
+
+	if (config_.env.end_episode_on_life_loss)
+	{
+		for (size_t i = 0; i < episode_result.life_length.size(); i++)
+		{
+			metrics_logger_.add_scalar("environment", "life_length", static_cast<float>(episode_result.life_length[i]));
+			metrics_logger_.add_scalar("environment", "reward", episode_result.life_reward[i]);
+		}
+	}
+	else
+	{
+		metrics_logger_.add_scalar("environment", "reward", episode_result.reward[0].item<float>());
+	}
+
+	metrics_logger_.add_scalar("environment", "score", episode_result.score.item<float>());
+}
+
+void AtariTrainingLogger::log_perf(const PerfCounters& interval)
+{
+	for (size_t i = 0; i < interval.size(); ++i)
+	{
+		const auto& counter = interval[i];
+		if (counter.calls == 0)
+		{
+			continue;
+		}
+		const std::string name = perf_stage_name(static_cast<PerfStage>(i));
+		// The time is summed over all threads, so it can exceed the wall time of the interval
+		metrics_logger_.add_scalar("perf", name + "_total_ms", static_cast<double>(counter.ns) / 1e6);
+		metrics_logger_.add_scalar(
+			"perf", name + "_mean_us", static_cast<double>(counter.ns) / static_cast<double>(counter.calls) / 1e3);
+	}
 }
 
 torch::Tensor AtariTrainingLogger::interactive_step()
@@ -229,6 +349,7 @@ void AtariTrainingLogger::save(int steps, const std::filesystem::path& path)
 
 void AtariTrainingLogger::save_episode_metrics(const EpisodeResult& episode)
 {
+	ATARI_TRACE_SCOPE("episode_metrics", "metrics");
 	auto path = buffer_path_ / ("episode_" + episode.name);
 	std::filesystem::create_directory(path);
 	nlohmann::json json;
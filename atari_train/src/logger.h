@@ -1,13 +1,19 @@
 #pragma once
 
 #include "atari_agent/configuration.h"
+#include "atari_agent/gif_stream.h"
+#include "atari_agent/perf.h"
+#include "atari_agent/recording.h"
+#include "log_worker.h"
+#include "mpsc_queue.h"
 
 #include <drla/auxiliary/metrics_logger.h>
 #include <drla/callback.h>
 
+#include <atomic>
 #include <chrono>
-#include <deque>
 #include <filesystem>
+#include <memory>
 #include <string>
 #include <vector>
 
@@ -22,7 +28,17 @@ struct EpisodeResult
 
 	torch::Tensor reward;
 	torch::Tensor score;
-	std::deque<drla::StepData> step_data;
+	// The last observation, only kept when rendering the final frame
+	torch::Tensor final_observation;
+	// The episode's visualisations, when rendering a gif to log to tensorboard
+	std::vector<drla::Observations> gif_frames;
+	// The number of visualisations captured, to decimate the gif frames
+	int visualisation_count = 0;
+	// Encodes the episode's visualisations as they are captured, when streaming gifs to files. Shared so the log worker
+	// can close it once the episode is complete.
+	std::shared_ptr<atari::GifStream> gif;
+	// The actions of the game, when recording episodes
+	std::shared_ptr<const atari::EpisodeRecording> recording;
 
 	// Indicates that this episode should be rendered
 	bool render_final = false;
@@ -45,19 +61,33 @@ private:
 	void save(int steps, const std::filesystem::path& path) override;
 
 	void save_episode_metrics(const EpisodeResult& episode);
+	void log_episode_scalars(const EpisodeResult& episode_result);
+	void log_perf(const atari::PerfCounters& interval);
 
 	atari::ConfigData config_;
 	std::filesystem::path buffer_path_;
+	std::filesystem::path gif_path_;
+	std::filesystem::path recording_path_;
 
 	drla::TrainingMetricsLogger metrics_logger_;
 
-	std::mutex m_step_;
+	// Encodes the streamed gifs of all episodes. Declared before the episodes so it outlives their gifs.
+	atari::GifEncoder gif_encoder_;
 
+	// The in progress episode of each env, which is only accessed by the env's own thread
 	std::vector<EpisodeResult> current_episodes_;
-	std::vector<EpisodeResult> episode_results_;
+	// Completed episodes, handed from the env threads to train_update
+	MPSCQueue<EpisodeResult> completed_episodes_;
 
-	int total_episode_count_ = 0;
-	int total_game_count_ = 0;
-	int next_gif_capture_ep_ = 0;
-	int next_final_capture_ep_ = 0;
+	std::atomic<int> total_episode_count_ = 0;
+	std::atomic<int> total_game_count_ = 0;
+	std::atomic<int> next_gif_capture_ep_ = 0;
+	std::atomic<int> next_final_capture_ep_ = 0;
+
+	// The hot path counters at the previous train_update
+	atari::PerfCounters last_perf_ = {};
+
+	// Runs the logging submitted by train_update. Declared last so queued tasks are completed before the state they use
+	// is destroyed.
+	LogWorker log_worker_;
 };
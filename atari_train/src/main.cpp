@@ -1,5 +1,7 @@
 #include "atari_agent.h"
 #include "atari_agent/configuration.h"
+#include "atari_agent/profiler.h"
+#include "atari_agent/trace.h"
 #include "atari_agent/utility.h"
 #include "logger.h"
 
@@ -10,6 +12,8 @@
 #include <cstdio>
 #include <filesystem>
 #include <functional>
+#include <memory>
+#include <vector>
 
 namespace
 {
@@ -40,6 +44,24 @@ int main(int argc, char** argv)
 		"The config directory path or full file path. Relative paths use the data path as the base.",
 		cxxopts::value<std::string>()->default_value(""))(
 		"d,data", "The data path for saving/loading the model and training state", cxxopts::value<std::string>())(
+		"profile",
+		"Profiles the throughput and where the time is spent, sweeping the env count. Trains a new model in a 'profile' "
+		"directory of the data path.",
+		cxxopts::value<bool>()->default_value("false"))(
+		"profile-policy",
+		"The policy to profile: 'model' trains the agent, 'random' or 'fixed' step the envs without the agent",
+		cxxopts::value<std::string>()->default_value("model"))(
+		"profile-envs",
+		"Comma separated env counts to profile. Defaults to powers of 2 up to the number of hardware threads",
+		cxxopts::value<std::string>()->default_value(""))(
+		"profile-steps",
+		"The number of train timesteps to profile, or steps per env without the agent",
+		cxxopts::value<int>()->default_value("1000"))(
+		"trace",
+		"Records a Chrome trace of the env, callback and logging spans to a trace_<time>.json file in the data path",
+		cxxopts::value<bool>()->default_value("false"))(
+		"trace-delay", "The seconds to wait before starting the trace", cxxopts::value<double>()->default_value("0"))(
+		"trace-duration", "The seconds to trace for", cxxopts::value<double>()->default_value("10"))(
 		"h,help", "This printout", cxxopts::value<bool>()->default_value("false"));
 	options.allow_unrecognised_options();
 	auto result = options.parse(argc, argv);
@@ -72,6 +94,52 @@ int main(int argc, char** argv)
 
 	auto config = atari::utility::load_config(config_path);
 
+	std::unique_ptr<atari::TraceRecorder> trace;
+	if (result["trace"].as<bool>())
+	{
+		trace = std::make_unique<atari::TraceRecorder>(
+			data_path / ("trace_" + atari::utility::get_time() + ".json"),
+			result["trace-delay"].as<double>(),
+			result["trace-duration"].as<double>());
+	}
+
+	if (result["profile"].as<bool>())
+	{
+		const auto policy = atari::parse_profile_policy(result["profile-policy"].as<std::string>());
+		const int steps = result["profile-steps"].as<int>();
+		const auto profile_path = data_path / "profile";
+		std::filesystem::create_directories(profile_path);
+		std::vector<atari::ProfileResult> results;
+		for (int env_count : atari::parse_profile_env_counts(result["profile-envs"].as<std::string>()))
+		{
+			spdlog::info("Profiling {} envs", env_count);
+			if (policy != atari::ProfilePolicy::kModel)
+			{
+				results.push_back(atari::profile_policy(config.env, env_count, steps, policy));
+				continue;
+			}
+			auto profile_config = config;
+			std::visit(
+				[&](auto& agent) {
+					agent.env_count = env_count;
+					std::visit(
+						[&](auto& train_algorithm) {
+							train_algorithm.total_timesteps = steps;
+							train_algorithm.start_timestep = 0;
+						},
+						agent.train_algorithm);
+				},
+				profile_config.agent);
+			AtariTrainingLogger profile_logger(profile_config, profile_path, false);
+			atari::ProfileCallback callback(&profile_logger);
+			atari::AtariAgent profile_atari_agent(atari::ConfigData(profile_config), &callback, profile_path);
+			// Training runs the configured timesteps, so the envs aren't stopped by the callback
+			results.push_back(atari::profile_agent(callback, env_count, 0, [&]() { profile_atari_agent.train(); }));
+		}
+		atari::print_profile(results);
+		return 0;
+	}
+
 	AtariTrainingLogger logger(config, data_path, resume);
 	atari::AtariAgent atari_agent(std::move(config), &logger, data_path);
 
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <atomic>
+#include <utility>
+
+/// @brief An unbounded lock-free multi-producer single-consumer queue. Any number of threads can push concurrently
+/// without blocking, while only a single thread may pop.
+template <typename T>
+class MPSCQueue
+{
+public:
+	MPSCQueue() : head_(&stub_), tail_(&stub_) {}
+
+	~MPSCQueue()
+	{
+		T value;
+		while (pop(value)) {}
+		if (tail_ != &stub_)
+		{
+			delete tail_;
+		}
+	}
+
+	MPSCQueue(const MPSCQueue&) = delete;
+	MPSCQueue& operator=(const MPSCQueue&) = delete;
+
+	/// @brief Adds an item to the back of the queue. Safe to call from any thread.
+	/// @param value The item to add
+	void push(T value)
+	{
+		auto* node = new Node{std::move(value), nullptr};
+		Node* prev = head_.exchange(node, std::memory_order_acq_rel);
+		prev->next.store(node, std::memory_order_release);
+	}
+
+	/// @brief Removes the item at the front of the queue. Must only be called from the consumer thread. An item which is
+	/// still being pushed may not be visible until its push completes.
+	/// @param value The item removed from the queue
+	/// @return True if an item was removed, false if the queue is empty
+	bool pop(T& value)
+	{
+		Node* tail = tail_;
+		Node* next = tail->next.load(std::memory_order_acquire);
+		if (next == nullptr)
+		{
+			return false;
+		}
+		// The front node acts as a placeholder, so the popped item's node becomes the new placeholder
+		value = std::move(next->value);
+		tail_ = next;
+		if (tail != &stub_)
+		{
+			delete tail;
+		}
+		return true;
+	}
+
+private:
+	struct Node
+	{
+		T value;
+		std::atomic<Node*> next;
+	};
+
+	Node stub_{T{}, nullptr};
+	std::atomic<Node*> head_;
+	Node* tail_;
+};